@@ -58,6 +58,7 @@ typedef struct Fonts Fonts;
 typedef struct Para Para;
 typedef struct Run Run;
 typedef struct Tab Tab;
+typedef struct Tblprops Tblprops;
 
 struct Fonts {
 	char *xml;
@@ -91,6 +92,13 @@ struct Para {
 	Tab tabs[Ntabs]; 	/* tab specs */
 };
 
+struct Tblprops {
+	int expand;
+	int center;
+	int allbox;
+	int nbox;			/* 1 box, 2 doublebox */
+};
+
 static struct {			/* map Word's paragraph styles to troff's */
 	char *name;
 	int style;
@@ -124,6 +132,65 @@ Fonts Fontmap[] = {					/* map Word's font names ot troff's */
 };
 
 
+enum {				/* element names we dispatch on, see Names[] */
+	Oleobject,
+	Wbr,
+	Wcr,
+	Wdrawing,
+	WfldSimple,
+	Wfootnote,
+	WfootnoteReference,
+	WgridCol,
+	Whyperlink,
+	Wobject,
+	Wp,
+	Wpict,
+	WpPr,
+	Wr,
+	WrPr,
+	Wt,
+	Wtab,
+	Wtbl,
+	WtblGrid,
+	WtblPr,
+	Wtc,
+	Wtr,
+	Natom
+};
+
+static char *Names[Natom] = {
+	[Oleobject]		"o:OLEObject",
+	[Wbr]			"w:br",
+	[Wcr]			"w:cr",
+	[Wdrawing]		"w:drawing",
+	[WfldSimple]		"w:fldSimple",
+	[Wfootnote]		"w:footnote",
+	[WfootnoteReference]	"w:footnoteReference",
+	[WgridCol]		"w:gridCol",
+	[Whyperlink]		"w:hyperlink",
+	[Wobject]		"w:object",
+	[Wp]			"w:p",
+	[Wpict]			"w:pict",
+	[WpPr]			"w:pPr",
+	[Wr]			"w:r",
+	[WrPr]			"w:rPr",
+	[Wt]			"w:t",
+	[Wtab]			"w:tab",
+	[Wtbl]			"w:tbl",
+	[WtblGrid]		"w:tblGrid",
+	[WtblPr]		"w:tblPr",
+	[Wtc]			"w:tc",
+	[Wtr]			"w:tr",
+};
+
+static int Atom[Natom];			/* Names[] as atoms */
+
+static char *Skip[] = {			/* contents never looked at */
+	"w:drawing",
+	"w:pict",
+	"mc:AlternateContent",
+};
+
 static int Col = 1;						/* column for wordwrap */
 static double Pagewidth = 6.5;			/* Word's page width */
 static double Defsize = 20;				/* Word's initial font size in ½ points */
@@ -147,6 +214,27 @@ static void setpara(Biobuf *bp, Para *pp, int newpara, int intable);
 
 static Elem *Footnotes;
 
+/*
+ * w:rPr, w:pPr and w:tblPr are each read by one Xmatch made
+ * in main, its handlers fill in the Run, Para or Tblprops
+ * passed to xmlmatch.
+ */
+static Xmatch *Rprmatch;
+static Xmatch *Pprmatch;
+static Xmatch *Tblmatch;
+
+static struct {
+	char *path;
+	int style;
+} Runstyles[] = {
+	{ "/w:b",			Bold },
+	{ "/w:i",			Italic },
+	{ "/w:u",			Underline },
+	{ "/w:strike",		Strikeout },
+	{ "/w:caps",		Allcaps },
+	{ "/w:smallCaps",	Smallcaps },
+};
+
 static void
 markpos(Biobuf *bp, Run *rp)
 {
@@ -280,7 +368,7 @@ object(Biobuf *bp, Elem *ep)
 	char *v, *p;
 
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "o:OLEObject") == 0)
+		if(ep->atom == Atom[Oleobject])
 			if((v = xmlvalue(ep, "ProgID")) != nil){
 				/* prettyness */
 				if((p = strrchr(v, '.')) != nil && atoi(p+1) != 0)
@@ -411,55 +499,52 @@ setrun(Biobuf *bp, Run *rp, int intable)
 }
 
 static void
-getstyle(Elem *ep, Run *rp, int flag)
+runstyle(Elem *ep, void *aux, void *arg)
 {
 	char *v;
 
 	if((v = xmlvalue(ep, "w:val")) != nil)
 		if(atoi(v) == 0)
 			return;
-	rp->style = flag;
+	((Run *)arg)->style = *(int *)aux;
+}
+
+static void
+runsize(Elem *ep, void *, void *arg)
+{
+	Run *rp;
+
+	rp = arg;
+	rp->size = xmlnum(ep, "w:val", rp->size);
+}
+
+static void
+runshift(Elem *ep, void *, void *arg)
+{
+	Run *rp;
+	char *v;
+
+	rp = arg;
+	if((v = xmlvalue(ep, "w:val")) != nil){
+		if(strcmp(v, "subscript") == 0)
+			rp->shift = Subscript;	
+		if(strcmp(v, "superscript") == 0)
+			rp->shift = Superscript;
+	}
 }
 
 static void
-runprops(Biobuf *bp, Elem *ep, Run *rp)
+runfont(Elem *ep, void *, void *arg)
 {
 	int i;
 	char *v;
 
-	USED(bp);
-	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:b") == 0)
-			getstyle(ep, rp, Bold);
-		if(strcmp(ep->name, "w:i") == 0)
-			getstyle(ep, rp, Italic);
-		if(strcmp(ep->name, "w:u") == 0)
-			getstyle(ep, rp, Underline);
-		if(strcmp(ep->name, "w:strike") == 0)
-			getstyle(ep, rp, Strikeout);
-		if(strcmp(ep->name, "w:caps") == 0)
-			getstyle(ep, rp, Allcaps);
-		if(strcmp(ep->name, "w:smallCaps") == 0)
-			getstyle(ep, rp, Smallcaps);
-		if(strcmp(ep->name, "w:sz") == 0)
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				rp->size = atoi(v);
-		if(strcmp(ep->name, "w:vertAlign") == 0)
-			if((v = xmlvalue(ep, "w:val")) != nil){
-				if(strcmp(v, "subscript") == 0)
-					rp->shift = Subscript;	
-				if(strcmp(v, "superscript") == 0)
-					rp->shift = Superscript;
+	if((v = xmlvalue(ep, "w:ascii")) != nil)
+		for(i = 0; i < nelem(Fontmap); i++)
+			if(strcmp(v, Fontmap[i].xml) == 0){
+				((Run *)arg)->font = i;
+				break;
 			}
-		if(strcmp(ep->name, "w:rFonts") == 0)
-			if((v = xmlvalue(ep, "w:ascii")) != nil)
-				for(i = 0; i < nelem(Fontmap); i++)
-					if(strcmp(v, Fontmap[i].xml) == 0){
-						rp->font = i;
-						break;
-					}
-		}
-
 }
 
 static void
@@ -469,7 +554,7 @@ footbody(Biobuf *bp, Elem *ep)
 
 	memset(&p, 0, sizeof(Para));
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:p") == 0 && ep->child)
+		if(ep->atom == Atom[Wp] && ep->child)
 			para(bp, ep->child, &p, 1);
 }
 
@@ -484,7 +569,7 @@ footnote(Biobuf *bp, char *id)
 
 	memset(&p, 0, sizeof(Para));
 	for(ep = Footnotes; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:footnote") == 0 && ep->child)
+		if(ep->atom == Atom[Wfootnote] && ep->child)
 			if((v = xmlvalue(ep, "w:id")) != nil)
 				if(strcmp(v, id) == 0){
 					ctrl(bp, "\n.FS\n");
@@ -512,26 +597,26 @@ run(Biobuf *bp, Para *pp, Elem *ep, int isleader, int intable)
 
 	tabstop = 0;
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:footnoteReference") == 0)
+		if(ep->atom == Atom[WfootnoteReference])
 			if((v = xmlvalue(ep, "w:id")) != nil)
 				footnote(bp, v);
 
-	if(strcmp(ep->name, "w:drawing") == 0)
+	if(ep->atom == Atom[Wdrawing])
 			ctrl(bp, "\n.ce 1\n[drawing]\n");
 
-		if(strcmp(ep->name, "w:pict") == 0)
+		if(ep->atom == Atom[Wpict])
 			ctrl(bp, "\n.ce 1\n[picture]\n");
 
-		if(strcmp(ep->name, "w:object") == 0 && ep->child){
+		if(ep->atom == Atom[Wobject] && ep->child){
 			ctrl(bp, "\n.ce 1\n[object: ");
 			object(bp, ep->child);
 			ctrl(bp, "]\n");
 		}
 
-		if(strcmp(ep->name, "w:cr") == 0)
+		if(ep->atom == Atom[Wcr])
 			ctrl(bp, "\n.br\n");
 
-		if(strcmp(ep->name, "w:br") == 0){
+		if(ep->atom == Atom[Wbr]){
 			brk = ".br";
 			if((v = xmlvalue(ep, "w:type")) != nil)
 				if(strcmp(v, "page") == 0)
@@ -539,15 +624,15 @@ run(Biobuf *bp, Para *pp, Elem *ep, int isleader, int intable)
 			ctrl(bp, "\n%s\n", brk);
 		}
 
-		if(strcmp(ep->name, "w:rPr") == 0 && ep->child)
-			runprops(bp, ep->child, &r);
+		if(ep->atom == Atom[WrPr] && ep->child)
+			xmlmatch(Rprmatch, ep->child, &r);
 
-		if(strcmp(ep->name, "w:t") == 0 && ep->pcdata){
+		if(ep->atom == Atom[Wt] && ep->pcdata){
 			setrun(bp, &r, intable);
 			text(bp, &r, ep->pcdata);
 		}
 
-		if(strcmp(ep->name, "w:tab") == 0){
+		if(ep->atom == Atom[Wtab]){
 			if(isleader)
 				Bprint(bp, "%c", 1);
 			else
@@ -569,7 +654,7 @@ cell(Biobuf *bp, Elem *ep, Para *pp)
 
 	first = 1;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:p") == 0 && ep->child){
+		if(ep->atom == Atom[Wp] && ep->child){
 			if(! first)
 				text(bp, nil, " ");
 			first = 0;
@@ -584,7 +669,7 @@ row(Biobuf *bp, Elem *ep, Para *pp)
 
 	first = 1;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:tc") == 0){
+		if(ep->atom == Atom[Wtc]){
 			if(! first)
 				ctrl(bp, "\t");
 			first = 0;
@@ -604,7 +689,7 @@ grid(Biobuf *bp, Elem *base)
 	double width;
 
 	for(ep = base; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:gridCol") == 0){
+		if(ep->atom == Atom[WgridCol]){
 			if((v = xmlvalue(ep, "w:w")) != nil){
 				width = Scalewidth * atof(v);
 				if(width < 0.01)				/* spurious fields (why are they here?) */
@@ -619,71 +704,78 @@ grid(Biobuf *bp, Elem *base)
 }
 
 static void
-borders(Elem *ep, int *nbox, int *allbox)
+tblwidth(Elem *ep, void *, void *arg)
 {
 	char *v;
 
-	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:top") == 0){
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				if(strcmp(v, "single") == 0)
-					*nbox = 1;
-				if(strcmp(v, "double") == 0)
-					*nbox = 2;
-		}
+	if((v = xmlvalue(ep, "w:type")) != nil)
+		if(strcmp(v, "auto") == 0)
+			((Tblprops *)arg)->expand = 1;
+}
 
-		if(strcmp(ep->name, "w:insideH") == 0){
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				if(strcmp(v, "nil") != 0)
-					*allbox = 1;
-		}
-	}
+static void
+tbljust(Elem *ep, void *, void *arg)
+{
+	char *v;
+
+	if((v = xmlvalue(ep, "w:val")) != nil)
+		if(strcmp(v, "center") == 0)
+			((Tblprops *)arg)->center = 1;
 }
 
 static void
-tableprops(Biobuf *bp, Elem *base)
+tblstyle(Elem *ep, void *, void *arg)
 {
 	char *v;
-	Elem *ep;
-	int expand, center, allbox, nbox;
 
-	nbox = 0;
-	expand = 0;
-	center = 0;
-	allbox = 0;
+	if((v = xmlvalue(ep, "w:val")) != nil)
+		if(strcmp(v, "TableGrid") == 0)
+			((Tblprops *)arg)->allbox = 1;
+}
 
-	for(ep = base; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:tblW") == 0)
-			if((v = xmlvalue(ep, "w:type")) != nil)
-				if(strcmp(v, "auto") == 0)
-					expand = 1;
-
-		if(strcmp(ep->name, "w:jc") == 0)
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				if(strcmp(v, "center") == 0)
-					center = 1;
-
-  		if(strcmp(ep->name, "w:tblStyle") == 0)
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				if(strcmp(v, "TableGrid") == 0){
-					allbox = 1;
-				}
+static void
+tbltop(Elem *ep, void *, void *arg)
+{
+	Tblprops *tp;
+	char *v;
 
-		if(strcmp(ep->name, "w:tblBorders") == 0 && ep->child)
-			borders(ep->child, &nbox, &allbox);
-	}
+	tp = arg;
+	if((v = xmlvalue(ep, "w:val")) != nil)
+		if(strcmp(v, "single") == 0)
+			tp->nbox = 1;
+		if(strcmp(v, "double") == 0)
+			tp->nbox = 2;
+}
+
+static void
+tblinside(Elem *ep, void *, void *arg)
+{
+	char *v;
+
+	if((v = xmlvalue(ep, "w:val")) != nil)
+		if(strcmp(v, "nil") != 0)
+			((Tblprops *)arg)->allbox = 1;
+}
+
+static void
+tableprops(Biobuf *bp, Elem *base)
+{
+	Tblprops t;
+
+	memset(&t, 0, sizeof(t));
+	xmlmatch(Tblmatch, base, &t);
 
 	ctrl(bp, "\n");
-	if(nbox == 1)
+	if(t.nbox == 1)
 		ctrl(bp, "box ");
-	if(nbox == 2)
+	if(t.nbox == 2)
 		ctrl(bp, "doublebox ");
-	if(center)
+	if(t.center)
 		ctrl(bp, "center ");
 	else					/* expand and center are mulually exclusive */
-	if(expand)
+	if(t.expand)
 		ctrl(bp, "expand ");
-	if(allbox)
+	if(t.allbox)
 		ctrl(bp, "allbox ");
 	ctrl(bp, ";\n");
 }
@@ -711,7 +803,7 @@ table(Biobuf *bp, Elem *base)
 	first = 1;
 	ctrl(bp, "\n.TS H\n");
 	for(ep = base; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:tr") == 0 && ep->child){
+		if(ep->atom == Atom[Wtr] && ep->child){
 			row(bp, ep->child, &p);
 
 			/*
@@ -723,10 +815,10 @@ table(Biobuf *bp, Elem *base)
 			first = 0;
 		}
 
-		if(strcmp(ep->name, "w:tblPr") == 0 && ep->child)
+		if(ep->atom == Atom[WtblPr] && ep->child)
 			tableprops(bp, ep->child);
 
-		if(strcmp(ep->name, "w:tblGrid") == 0 && ep->child)
+		if(ep->atom == Atom[WtblGrid] && ep->child)
 			grid(bp, ep->child);
 
 	}
@@ -736,32 +828,28 @@ table(Biobuf *bp, Elem *base)
 
 
 static void
-tabs(Elem *ep, Para *pp)
+paratab(Elem *ep, void *, void *arg)
 {
+	Para *pp;
 	char *v;
 	Tab *tp;
 
-	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:tab") == 0){
-			tp = &pp->tabs[pp->ntab++];
-
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				if(strcmp(v, "right") == 0)
-					tp->just = Right;
-				if(strcmp(v, "left") == 0)
-					tp->just = Left;
-				if(strcmp(v, "center") == 0)
-					tp->just = Center;
-
-			if((v = xmlvalue(ep, "w:leader")) != nil)
-				if(strcmp(v, "dot") == 0)
-					tp->style = Dotted;
-
-			if((v = xmlvalue(ep, "w:pos")) != nil)
-				tp->pos = atoi(v);
-		}
-	}
+	pp = arg;
+	tp = &pp->tabs[pp->ntab++];
 
+	if((v = xmlvalue(ep, "w:val")) != nil)
+		if(strcmp(v, "right") == 0)
+			tp->just = Right;
+		if(strcmp(v, "left") == 0)
+			tp->just = Left;
+		if(strcmp(v, "center") == 0)
+			tp->just = Center;
+
+	if((v = xmlvalue(ep, "w:leader")) != nil)
+		if(strcmp(v, "dot") == 0)
+			tp->style = Dotted;
+
+	tp->pos = xmlnum(ep, "w:pos", tp->pos);
 }
 
 static int
@@ -785,59 +873,69 @@ tabcmp(int na, Tab *a, int nb, Tab *b)
 static void
 listprops(Elem *ep, Para *pp)
 {
-	char *v;
-
 	for(; ep; ep = ep->next){
 		if(cistrcmp(ep->name, "w:ilvl") == 0)
-			if((v = xmlvalue(ep, "w:val")) != nil)
-				pp->level = atoi(v);
+			pp->level = xmlnum(ep, "w:val", pp->level);
 	}
 			
 }
 
 static void
-paraprops(Elem *ep, Para *pp)
+parajust(Elem *ep, void *, void *arg)
 {
-	int i;
+	Para *pp;
 	char *v;
 
-	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:tabs") == 0 && ep->child)
-			tabs(ep->child, pp);
-
-		if(strcmp(ep->name, "w:jc") == 0)	
-			if((v = xmlvalue(ep, "w:val")) != nil){
-				if(strcmp(v, "right") == 0)
-					pp->just = Right;
-				if(strcmp(v, "center") == 0)
-					pp->just = Center;
-				if(strcmp(v, "both") == 0)
-					pp->just = Fill;
-			}
+	pp = arg;
+	if((v = xmlvalue(ep, "w:val")) != nil){
+		if(strcmp(v, "right") == 0)
+			pp->just = Right;
+		if(strcmp(v, "center") == 0)
+			pp->just = Center;
+		if(strcmp(v, "both") == 0)
+			pp->just = Fill;
+	}
+}
 
-		if(strcmp(ep->name, "w:ind") == 0){
-			if((v = xmlvalue(ep, "w:left")) != nil)
-				pp->left = atoi(v);
-			if((v = xmlvalue(ep, "w:right")) != nil)
-				pp->right = atoi(v);
-		}
+static void
+paraindent(Elem *ep, void *, void *arg)
+{
+	Para *pp;
 
-		if(strcmp(ep->name, "w:numPr") == 0 && ep->child){
-			pp->style = List;
-			listprops(ep->child, pp);
-		}
+	pp = arg;
+	pp->left = xmlnum(ep, "w:left", pp->left);
+	pp->right = xmlnum(ep, "w:right", pp->right);
+}
 
-		if(strcmp(ep->name, "w:pBdr") == 0){
-			pp->style = Boxed;
-		}
+static void
+paralist(Elem *ep, void *, void *arg)
+{
+	Para *pp;
+
+	pp = arg;
+	if(ep->child){
+		pp->style = List;
+		listprops(ep->child, pp);
+	}
+}
+
+static void
+paraboxed(Elem *, void *, void *arg)
+{
+	((Para *)arg)->style = Boxed;
+}
 
-		if(strcmp(ep->name, "w:pStyle") == 0)
-			if((v = xmlvalue(ep, "w:val")) != nil){
-				for(i = 0; i < nelem(Stylemap); i++)
-					if(strcmp(v, Stylemap[i].name) == 0){
-						pp->style = Stylemap[i].style;
-						break;
-					}
+static void
+parastyle(Elem *ep, void *, void *arg)
+{
+	int i;
+	char *v;
+
+	if((v = xmlvalue(ep, "w:val")) != nil){
+		for(i = 0; i < nelem(Stylemap); i++)
+			if(strcmp(v, Stylemap[i].name) == 0){
+				((Para *)arg)->style = Stylemap[i].style;
+				break;
 			}
 	}
 }
@@ -1002,10 +1100,10 @@ para(Biobuf *bp, Elem *ep, Para *pp, int intable)
 	tabstop = 0;		/* start with empty list of tabstops */
 
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:pPr") == 0 && ep->child)
-			paraprops(ep->child, &p);
+		if(ep->atom == Atom[WpPr] && ep->child)
+			xmlmatch(Pprmatch, ep->child, &p);
 
-		if(strcmp(ep->name, "w:r") == 0 && ep->child){
+		if(ep->atom == Atom[Wr] && ep->child){
 			setpara(bp, &p, first, intable);
 			first = 0;
 
@@ -1016,11 +1114,11 @@ para(Biobuf *bp, Elem *ep, Para *pp, int intable)
 			tabstop += run(bp, &p, ep->child, isleader, intable);
 		}
 
-		if(strcmp(ep->name, "w:hyperlink") == 0 && ep->child)
+		if(ep->atom == Atom[Whyperlink] && ep->child)
 			para(bp, ep->child, &p, intable);
 
 		/* autogenerated fields, e.g. auto numbered Figures */
-		if(strcmp(ep->name, "w:fldSimple") == 0 && ep->child)
+		if(ep->atom == Atom[WfldSimple] && ep->child)
 			para(bp, ep->child, &p, intable);
 	}
 }
@@ -1032,25 +1130,69 @@ body(Biobuf *bp, Elem *ep)
 
 	memset(&p, 0, sizeof(Para));
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:p") == 0 && ep->child)
+		if(ep->atom == Atom[Wp] && ep->child)
 			para(bp, ep->child, &p, 0);
-		if(strcmp(ep->name, "w:tbl") == 0 && ep->child)
+		if(ep->atom == Atom[Wtbl] && ep->child)
 			table(bp, ep->child);
 	}
 }
 
+static Xmatch *
+newmatch(void)
+{
+	Xmatch *m;
+
+	if((m = xmlmatchnew()) == nil)
+		sysfatal("no memory");
+	return m;
+}
+
+static void
+mkmatch(void)
+{
+	int i;
+
+	Rprmatch = newmatch();
+	for(i = 0; i < nelem(Runstyles); i++)
+		xmlmatchadd(Rprmatch, Runstyles[i].path, runstyle, &Runstyles[i].style);
+	xmlmatchadd(Rprmatch, "/w:sz", runsize, nil);
+	xmlmatchadd(Rprmatch, "/w:vertAlign", runshift, nil);
+	xmlmatchadd(Rprmatch, "/w:rFonts", runfont, nil);
+
+	Pprmatch = newmatch();
+	xmlmatchadd(Pprmatch, "/w:tabs/w:tab", paratab, nil);
+	xmlmatchadd(Pprmatch, "/w:jc", parajust, nil);
+	xmlmatchadd(Pprmatch, "/w:ind", paraindent, nil);
+	xmlmatchadd(Pprmatch, "/w:numPr", paralist, nil);
+	xmlmatchadd(Pprmatch, "/w:pBdr", paraboxed, nil);
+	xmlmatchadd(Pprmatch, "/w:pStyle", parastyle, nil);
+
+	Tblmatch = newmatch();
+	xmlmatchadd(Tblmatch, "/w:tblW", tblwidth, nil);
+	xmlmatchadd(Tblmatch, "/w:jc", tbljust, nil);
+	xmlmatchadd(Tblmatch, "/w:tblStyle", tblstyle, nil);
+	xmlmatchadd(Tblmatch, "/w:tblBorders/w:top", tbltop, nil);
+	xmlmatchadd(Tblmatch, "/w:tblBorders/w:insideH", tblinside, nil);
+}
+
 static Xml *
 parsefile(char *mnt, char *path)
 {
 	char *s;
 	Xml *xp;
-	int fd;
+	int i, fd;
 
 	s = smprint("%s/%s", mnt, path);
 	if((fd = open(s, OREAD)) == -1)
 		return nil;
-	if((xp = xmlparse(fd, 8192, 0)) == nil)
+	if((xp = xmlnew(8192)) == nil)
+		return nil;
+	for(i = 0; i < nelem(Skip); i++)
+		xmlskip(xp, Skip[i]);
+	if(xmlreparse(xp, fd, Fparallel|Fintern) == -1){
+		xmlfree(xp);
 		return nil;
+	}
 	close(fd);
 	free(s);
 	return xp;
@@ -1067,6 +1209,7 @@ usage(void)
 void
 main(int argc, char *argv[])
 {
+	int i;
 	Elem *ep;
 	Biobuf bout;
 	Xml *xpDoc, *xpNote;
@@ -1082,6 +1225,10 @@ main(int argc, char *argv[])
 	if(argc == 0)
 		usage();
 
+	for(i = 0; i < Natom; i++)
+		Atom[i] = xmlatom(Names[i]);
+	mkmatch();
+
 	Binit(&bout, 1, OWRITE);
 	if((xpNote = parsefile(argv[0], "word/footnotes.xml")) != nil){
 		if((ep = xmllook(xpNote->root, "/w:footnotes/w:footnote", nil, nil)) == nil || ep->child == nil)
@@ -8,6 +8,51 @@
 #include <xml.h>
 #include <ctype.h>
 
+enum {				/* element names we dispatch on, see Names[] */
+	Oleobject,
+	Wdrawing,
+	WfldSimple,
+	Whyperlink,
+	WnumPr,
+	Wobject,
+	Wp,
+	Wpict,
+	WpPr,
+	Wr,
+	Wt,
+	Wtab,
+	Wtbl,
+	Wtc,
+	Wtr,
+	Natom
+};
+
+static char *Names[Natom] = {
+	[Oleobject]	"o:OLEObject",
+	[Wdrawing]	"w:drawing",
+	[WfldSimple]	"w:fldSimple",
+	[Whyperlink]	"w:hyperlink",
+	[WnumPr]	"w:numPr",
+	[Wobject]	"w:object",
+	[Wp]		"w:p",
+	[Wpict]		"w:pict",
+	[WpPr]		"w:pPr",
+	[Wr]		"w:r",
+	[Wt]		"w:t",
+	[Wtab]		"w:tab",
+	[Wtbl]		"w:tbl",
+	[Wtc]		"w:tc",
+	[Wtr]		"w:tr",
+};
+
+static int Atom[Natom];		/* Names[] as atoms */
+
+static char *Skip[] = {		/* contents never looked at */
+	"w:drawing",
+	"w:pict",
+	"mc:AlternateContent",
+};
+
 static void para(Biobuf *bp, Elem *ep);
 
 static void
@@ -16,7 +61,7 @@ object(Biobuf *bp, Elem *ep)
 	char *v, *p;
 
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "o:OLEObject") == 0)
+		if(ep->atom == Atom[Oleobject])
 			if((v = xmlvalue(ep, "ProgID")) != nil){
 				/* trim cruft */
 				if((p = strrchr(v, '.')) != nil && atoi(p+1) != 0)
@@ -30,22 +75,22 @@ static void
 run(Biobuf *bp, Elem *ep)
 {
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:drawing") == 0)
+		if(ep->atom == Atom[Wdrawing])
 			Bprint(bp, "[drawing]");
 
-		if(strcmp(ep->name, "w:pict") == 0)
+		if(ep->atom == Atom[Wpict])
 			Bprint(bp, "[picture]");
 
-		if(strcmp(ep->name, "w:object") == 0 && ep->child){
+		if(ep->atom == Atom[Wobject] && ep->child){
 			Bprint(bp, "[object: ");
 			object(bp, ep->child);
 			Bprint(bp, "]");
 		}
 
-		if(strcmp(ep->name, "w:t") == 0 && ep->pcdata)
+		if(ep->atom == Atom[Wt] && ep->pcdata)
 			Bprint(bp, "%s", ep->pcdata);
 
-		if(strcmp(ep->name, "w:tab") == 0)
+		if(ep->atom == Atom[Wtab])
 			Bprint(bp, "\t");
 	}
 }
@@ -58,7 +103,7 @@ cell(Biobuf *bp, Elem *ep)
 
 	first = 1;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:p") == 0 && ep->child){
+		if(ep->atom == Atom[Wp] && ep->child){
 			if(! first)
 				Bprint(bp, " ");
 			first = 0;
@@ -70,7 +115,7 @@ static void
 row(Biobuf *bp, Elem *ep)
 {
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:tc") == 0){
+		if(ep->atom == Atom[Wtc]){
 			Bprint(bp, "\t");
 			cell(bp, ep->child);
 		}
@@ -82,7 +127,7 @@ static void
 table(Biobuf *bp, Elem *ep)
 {
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:tr") == 0 && ep->child)
+		if(ep->atom == Atom[Wtr] && ep->child)
 			row(bp, ep->child);
 }
 
@@ -90,7 +135,7 @@ static void
 paraprops(Biobuf *bp, Elem *ep)
 {
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "w:numPr") == 0 && ep->child)
+		if(ep->atom == Atom[WnumPr] && ep->child)
 			Bprint(bp, "    • ");
 }
 	
@@ -98,17 +143,17 @@ static void
 para(Biobuf *bp, Elem *ep)
 {
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:pPr") == 0 && ep->child)
+		if(ep->atom == Atom[WpPr] && ep->child)
 			paraprops(bp, ep->child);
 
-		if(strcmp(ep->name, "w:r") == 0 && ep->child)
+		if(ep->atom == Atom[Wr] && ep->child)
 			run(bp, ep->child);
 
-		if(strcmp(ep->name, "w:hyperlink") == 0 && ep->child)
+		if(ep->atom == Atom[Whyperlink] && ep->child)
 			para(bp, ep->child);
 
 		/* autogenerated fields, e.g. auto numbered Figures */
-		if(strcmp(ep->name, "w:fldSimple") == 0 && ep->child)
+		if(ep->atom == Atom[WfldSimple] && ep->child)
 			para(bp, ep->child);
 
 	}
@@ -119,11 +164,11 @@ static void
 body(Biobuf *bp, Elem *ep)
 {
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "w:p") == 0 && ep->child){
+		if(ep->atom == Atom[Wp] && ep->child){
 			para(bp, ep->child);
 			Bprint(bp, "\n\n");
 		}
-		if(strcmp(ep->name, "w:tbl") == 0 && ep->child){
+		if(ep->atom == Atom[Wtbl] && ep->child){
 			Bprint(bp, "\n");
 			table(bp, ep->child);
 		}
@@ -140,7 +185,7 @@ usage(void)
 void
 main(int argc, char *argv[])
 {
-	int fd;	
+	int i, fd;	
 	Xml *xp;
 	Elem *ep;
 	char *err;
@@ -155,14 +200,22 @@ main(int argc, char *argv[])
 		usage();
 	}ARGEND;
 
+	for(i = 0; i < Natom; i++)
+		Atom[i] = xmlatom(Names[i]);
+
+	if((xp = xmlnew(8192)) == nil)
+		sysfatal("no memory\n");
+	for(i = 0; i < nelem(Skip); i++)
+		xmlskip(xp, Skip[i]);
+
 	if(argc == 0){
-		if((xp = xmlparse(0, 8192, 0)) == nil)
+		if(xmlreparse(xp, 0, Fparallel) == -1)
 			sysfatal("stdin: %r\n");
 	}
 	else{
 		if((fd = open(argv[0], OREAD)) == -1)
 			sysfatal("%s cannot open\n", argv[0]);
-		if((xp = xmlparse(fd, 8192, 0)) == nil)
+		if(xmlreparse(xp, fd, Fparallel) == -1)
 			sysfatal("%s: %r\n", argv[0]);
 		close(fd);
 	}
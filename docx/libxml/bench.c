@@ -0,0 +1,380 @@
+/*
+ * Time the parser and friends on made up documents of
+ * various shapes, to catch regressions before they ship.
+ *
+ *	8.bench [-p] [-n runs] [-s MB] [shape ...]
+ *
+ * Each document is written to /tmp first and read from
+ * there, so after the first run it comes from the cache.
+ * Parse and print rates are MB of input per second, the
+ * best of the runs; lookups are microseconds per call;
+ * walks, through the Elems and through xmlflatten's copy,
+ * are milliseconds for the whole tree.
+ */
+#include <u.h>
+#include <libc.h>
+#include <bio.h>
+#include "xml.h"
+
+typedef struct Shape Shape;
+struct Shape {
+	char	*name;
+	void	(*gen)(Biobuf *, vlong);
+	char	*find;			/* path for xmlfind */
+	char	*look;			/* path, attr and value for xmllook */
+	char	*attr;
+	char	*value;
+};
+
+static char *words[] = {
+	"lorem", "ipsum", "dolor", "sit", "amet", "alpha", "beta",
+	"gamma", "delta", "epsilon",
+};
+
+static int	runs = 5;
+static int	flags;
+
+static char *
+word(int i)
+{
+	return words[i % nelem(words)];
+}
+
+static void
+genwide(Biobuf *bp, vlong size)
+{
+	int i;
+
+	Bprint(bp, "<list>\n");
+	for(i = 0; Boffset(bp) < size; i++)
+		Bprint(bp, "<item id='%d'>%s %s</item>\n", i, word(i), word(i/7));
+	Bprint(bp, "<item id='last'/>\n</list>\n");
+}
+
+static void
+gendeep(Biobuf *bp, vlong size)
+{
+	int i, d;
+
+	Bprint(bp, "<tree>\n");
+	for(i = 0; Boffset(bp) < size; i++){
+		for(d = 0; d < 64; d++)
+			Bprint(bp, "<node depth='%d'>", d);
+		Bprint(bp, "%s", word(i));
+		for(d = 0; d < 64; d++)
+			Bprint(bp, "</node>");
+		Bprint(bp, "\n");
+	}
+	Bprint(bp, "<node depth='last'/>\n</tree>\n");
+}
+
+static void
+genattr(Biobuf *bp, vlong size)
+{
+	int i, a;
+
+	Bprint(bp, "<table>\n");
+	for(i = 0; Boffset(bp) < size; i++){
+		Bprint(bp, "<cell");
+		for(a = 0; a < 16; a++)
+			Bprint(bp, " a%d='%s%d'", a, word(i+a), i);
+		Bprint(bp, "/>\n");
+	}
+	Bprint(bp, "<cell a0='last'/>\n</table>\n");
+}
+
+static void
+gentext(Biobuf *bp, vlong size)
+{
+	int i, w;
+
+	Bprint(bp, "<text>\n");
+	for(i = 0; Boffset(bp) < size; i++){
+		Bprint(bp, "<para n='%d'>", i);
+		for(w = 0; w < 800; w++)
+			Bprint(bp, "%s ", word(i+w*3));
+		Bprint(bp, "</para>\n");
+	}
+	Bprint(bp, "<para n='last'/>\n</text>\n");
+}
+
+static void
+genentity(Biobuf *bp, vlong size)
+{
+	int i;
+
+	Bprint(bp, "<text>\n");
+	for(i = 0; Boffset(bp) < size; i++)
+		Bprint(bp, "<s n='%d' q='&quot;%s&quot;'>%s &amp; %s &lt;&gt; &#x41;&#169;&#8364; &apos;%s&apos;</s>\n",
+			i, word(i), word(i), word(i+1), word(i+2));
+	Bprint(bp, "<s n='last'/>\n</text>\n");
+}
+
+static void
+genns(Biobuf *bp, vlong size)
+{
+	int i;
+
+	Bprint(bp, "<?xml version='1.0' encoding='UTF-8' standalone='yes'?>\n");
+	Bprint(bp, "<w:document xmlns:w='http://schemas.openxmlformats.org/wordprocessingml/2006/main'"
+		" xmlns:r='http://schemas.openxmlformats.org/officeDocument/2006/relationships'"
+		" xmlns:mc='http://schemas.openxmlformats.org/markup-compatibility/2006'><w:body>\n");
+	for(i = 0; Boffset(bp) < size; i++){
+		Bprint(bp, "<w:p w:rsidR='%08X' w:rsidRDefault='%08X'>", i, i*7);
+		Bprint(bp, "<w:pPr><w:pStyle w:val='Heading%d'/><w:spacing w:before='120' w:after='60'/></w:pPr>", i%4);
+		Bprint(bp, "<w:r><w:rPr><w:b/><w:i w:val='0'/><w:sz w:val='24'/></w:rPr>");
+		Bprint(bp, "<w:t xml:space='preserve'>%s %s %s</w:t></w:r>", word(i), word(i+1), word(i+2));
+		Bprint(bp, "<w:r><w:t>%s</w:t></w:r></w:p>\n", word(i+3));
+	}
+	Bprint(bp, "<w:p w:rsidR='last'/>\n<w:sectPr/></w:body></w:document>\n");
+}
+
+static Shape shapes[] = {
+	{ "wide",	genwide,	"list/nothing",		"list/item",	"id",	"last" },
+	{ "deep",	gendeep,	"tree/node/node/nothing",	"tree/node",	"depth",	"last" },
+	{ "attr",	genattr,	"table/nothing",	"table/cell",	"a0",	"last" },
+	{ "text",	gentext,	"text/nothing",	"text/para",	"n",	"last" },
+	{ "entity",	genentity,	"text/nothing",	"text/s",	"n",	"last" },
+	{ "ns",	genns,	"w:document/w:body/w:sectPr",	"w:document/w:body/w:p",	"w:rsidR",	"last" },
+};
+
+/*
+ * our memory size in Kbytes from /proc. Each shape is run
+ * in a proc of its own and malloc never gives the heap
+ * back, so after its parses this is the most that shape
+ * took, not counting those before it.
+ */
+static long
+memsize(void)
+{
+	int fd, n;
+	char buf[512], *f[16];
+
+	snprint(buf, sizeof(buf), "/proc/%d/status", getpid());
+	if((fd = open(buf, OREAD)) < 0)
+		return -1;
+	n = read(fd, buf, sizeof(buf)-1);
+	close(fd);
+	if(n <= 0)
+		return -1;
+	buf[n] = 0;
+	if(tokenize(buf, f, nelem(f)) < 10)
+		return -1;
+	return atol(f[9]);
+}
+
+static double
+rate(vlong bytes, vlong ns)
+{
+	if(ns <= 0)
+		return 0.0;
+	return (bytes / (1024.0*1024.0)) / (ns / 1e9);
+}
+
+/*
+ * visit every element and attribute, as a converter would
+ */
+static int
+walk(Elem *ep)
+{
+	int n;
+	Attr *ap;
+
+	for(n = 0; ep; ep = ep->next){
+		n++;
+		for(ap = ep->attrs; ap; ap = ap->next)
+			n++;
+		n += walk(ep->child);
+	}
+	return n;
+}
+
+static int
+walkflat(Xflat *f)
+{
+	int n, m;
+	Xiter it;
+
+	xmliter(&it, f, 0);
+	for(n = 0; (m = xmliternext(&it)) != 0; n++)
+		n += f->node[m+1].attr - f->node[m].attr;
+	return n;
+}
+
+static Xml *
+parse(char *file, vlong *best)
+{
+	int i, fd;
+	vlong t;
+	Xml *xp;
+
+	xp = nil;
+	*best = 0;
+	for(i = 0; i < runs; i++){
+		if(xp)
+			xmlfree(xp);
+		if((fd = open(file, OREAD)) < 0)
+			sysfatal("%s: %r", file);
+		t = nsec();
+		if((xp = xmlparse(fd, 8192, flags)) == nil)
+			sysfatal("%s: %r", file);
+		t = nsec() - t;
+		close(fd);
+		if(*best == 0 || t < *best)
+			*best = t;
+	}
+	return xp;
+}
+
+static void
+bench(Shape *sp, vlong size)
+{
+	int i, n, fd;
+	char file[64];
+	vlong t, best, walkns, flatns;
+	Biobuf *bp;
+	Xml *xp;
+	Xflat *f;
+	Xstats st;
+	Elem *ep;
+
+	snprint(file, sizeof(file), "/tmp/xmlbench.%d.%s", getpid(), sp->name);
+	if((bp = Bopen(file, OWRITE)) == nil)
+		sysfatal("%s: %r", file);
+	sp->gen(bp, size);
+	size = Boffset(bp);
+	Bterm(bp);
+
+	xp = parse(file, &best);
+	xmlstats(xp, &st);
+	print("%-7s parse	%6.1fMB %8.1fMB/s allocs=%d arena=%lld blocks=%d elems=%d attrs=%d depth=%d procmem=%ldK\n",
+		sp->name, size / (1024.0*1024.0), rate(size, best),
+		st.allocs, st.requested + st.wasted, st.blocks,
+		st.elems, st.attrs, st.maxdepth, memsize());
+
+	n = 0;
+	t = nsec();
+	do{
+		ep = xmlfind(xp, xp->root, sp->find);
+		USED(ep);
+		n++;
+	}while(nsec() - t < 200*1000*1000LL);
+	t = nsec() - t;
+	print("%-7s find	%8.1fµs/call\n", sp->name, t / 1000.0 / n);
+
+	n = 0;
+	t = nsec();
+	do{
+		if(xmllook(xp->root, sp->look, sp->attr, sp->value) == nil)
+			sysfatal("%s: xmllook %s failed", sp->name, sp->look);
+		n++;
+	}while(nsec() - t < 200*1000*1000LL);
+	t = nsec() - t;
+	print("%-7s look	%8.1fµs/call\n", sp->name, t / 1000.0 / n);
+
+	walkns = 0;
+	for(i = 0; i < runs; i++){
+		t = nsec();
+		n = walk(xp->root);
+		t = nsec() - t;
+		if(walkns == 0 || t < walkns)
+			walkns = t;
+	}
+	t = nsec();
+	if((f = xmlflatten(xp)) == nil)
+		sysfatal("%s: xmlflatten: %r", sp->name);
+	t = nsec() - t;
+	flatns = 0;
+	for(i = 0; i < runs; i++){
+		best = nsec();
+		if(walkflat(f) != n)
+			sysfatal("%s: flat tree differs", sp->name);
+		best = nsec() - best;
+		if(flatns == 0 || best < flatns)
+			flatns = best;
+	}
+	print("%-7s walk	%8.1fms flat %.1fms flatten=%.1fms flat size=%lldK\n",
+		sp->name, walkns / 1e6, flatns / 1e6, t / 1e6,
+		((vlong)(f->nnode+1)*sizeof(Xnode) + (vlong)f->nattr*sizeof(Xattr) + f->ntext) / 1024);
+	xmlflatfree(f);
+
+	if((fd = open("/dev/null", OWRITE)) < 0)
+		sysfatal("/dev/null: %r");
+	best = 0;
+	for(i = 0; i < runs; i++){
+		t = nsec();
+		xmlprint(xp, fd);
+		t = nsec() - t;
+		if(best == 0 || t < best)
+			best = t;
+	}
+	close(fd);
+	print("%-7s print	%8.1fMB/s\n", sp->name, rate(size, best));
+
+	xmlfree(xp);
+	remove(file);
+}
+
+/*
+ * bench sp in a child, so its memory is its own
+ */
+static void
+run(Shape *sp, vlong size)
+{
+	switch(rfork(RFPROC|RFFDG)){
+	case -1:
+		sysfatal("rfork: %r");
+	case 0:
+		bench(sp, size);
+		exits(nil);
+	}
+	if(waitpid() < 0)
+		sysfatal("waitpid: %r");
+}
+
+static void
+usage(void)
+{
+	fprint(2, "usage: %s [-p] [-n runs] [-s MB] [shape ...]\n", argv0);
+	exits("usage");
+}
+
+void
+main(int argc, char *argv[])
+{
+	int i, j;
+	vlong size;
+
+	size = 8;
+	ARGBEGIN{
+	case 'n':
+		runs = atoi(EARGF(usage()));
+		break;
+	case 'p':
+		flags |= Fparallel;
+		break;
+	case 's':
+		size = atoll(EARGF(usage()));
+		break;
+	default:
+		usage();
+	}ARGEND
+	if(runs < 1 || size < 1)
+		usage();
+	size *= 1024*1024;
+
+	if(argc == 0){
+		for(i = 0; i < nelem(shapes); i++)
+			run(&shapes[i], size);
+		exits(nil);
+	}
+	for(j = 0; j < argc; j++){
+		for(i = 0; i < nelem(shapes); i++)
+			if(strcmp(argv[j], shapes[i].name) == 0)
+				break;
+		if(i == nelem(shapes))
+			sysfatal("%s: unknown shape", argv[j]);
+		run(&shapes[i], size);
+	}
+	exits(nil);
+}
@@ -0,0 +1,249 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * A finished tree copied into three arrays: nodes in
+ * document order, attributes in the same order and one
+ * block of text. Links are 32 bit indices rather than
+ * pointers and strings are offsets, so on a 64 bit
+ * machine a node takes little more than half the room of
+ * an Elem and an attribute less than half that of an
+ * Attr, with no arena overhead, and a walk reads memory
+ * front to back. node[0] stands for the document, its
+ * children are the top level elements; index 0 as a link
+ * is none. A node's attributes run up to the next node's,
+ * there is one node past the end to make that work.
+ * The copy shares nothing with the Xml, which may be
+ * freed as soon as it is made.
+ */
+
+typedef struct Count Count;
+struct Count {
+	int	nnode;
+	int	nattr;
+	long	ntext;
+};
+
+typedef struct Fill Fill;
+struct Fill {
+	Xflat	*f;
+	int	nnode;
+	int	nattr;
+	long	ntext;
+};
+
+static void
+count(Count *c, Elem *ep)
+{
+	Attr *ap;
+	Elem *cp;
+
+	for(; ep; ep = ep->next){
+		c->nnode++;
+		cp = xmlchild(ep);	/* sets pcdata too */
+		if(ep->pcdata)
+			c->ntext += strlen(ep->pcdata)+1;
+		for(ap = ep->attrs; ap; ap = ap->next){
+			c->nattr++;
+			if(ap->value)
+				c->ntext += strlen(ap->value)+1;
+		}
+		count(c, cp);
+	}
+}
+
+static int
+text(Fill *fl, char *s, int *np)
+{
+	int n;
+	long off;
+
+	*np = 0;
+	if(s == nil)
+		return -1;
+	n = strlen(s);
+	off = fl->ntext;
+	memmove(fl->f->text+off, s, n+1);
+	fl->ntext += n+1;
+	*np = n;
+	return off;
+}
+
+/*
+ * add ep and its siblings as children of parent, returns
+ * the index of the first
+ */
+static int
+fill(Fill *fl, Elem *ep, int parent)
+{
+	int n, first, prev;
+	Attr *ap;
+	Xnode *np;
+	Xattr *xp;
+
+	first = 0;
+	prev = 0;
+	for(; ep; ep = ep->next){
+		n = fl->nnode++;
+		np = &fl->f->node[n];
+		np->atom = ep->atom;
+		np->local = ep->local;
+		np->ns = ep->ns;
+		np->parent = parent;
+		np->line = ep->line;
+		np->text = text(fl, ep->pcdata, &np->ntext);
+		np->attr = fl->nattr;
+		for(ap = ep->attrs; ap; ap = ap->next){
+			xp = &fl->f->attr[fl->nattr++];
+			xp->atom = ap->atom;
+			xp->local = ap->local;
+			xp->ns = ap->ns;
+			xp->value = text(fl, ap->value, &xp->nvalue);
+		}
+		if(prev)
+			fl->f->node[prev].next = n;
+		else
+			first = n;
+		prev = n;
+		np->child = fill(fl, ep->child, n);
+	}
+	return first;
+}
+
+/*
+ * copy xp's tree into one made of arrays. Contents put off
+ * by Flazy are parsed first. nil if memory runs out.
+ */
+Xflat *
+xmlflatten(Xml *xp)
+{
+	Count c;
+	Fill fl;
+	Xflat *f;
+
+	memset(&c, 0, sizeof(c));
+	c.nnode = 1;
+	count(&c, xp->root);
+
+	if((f = mallocz(sizeof(Xflat), 1)) == nil)
+		return nil;
+	f->node = mallocz((c.nnode+1) * sizeof(Xnode), 1);
+	f->attr = malloc((c.nattr? c.nattr: 1) * sizeof(Xattr));
+	f->text = malloc(c.ntext? c.ntext: 1);
+	if(f->node == nil || f->attr == nil || f->text == nil){
+		xmlflatfree(f);
+		return nil;
+	}
+
+	fl.f = f;
+	fl.nnode = 1;
+	fl.nattr = 0;
+	fl.ntext = 0;
+	f->node[0].text = -1;
+	f->node[0].child = fill(&fl, xp->root, 0);
+	f->nnode = fl.nnode;
+	f->nattr = fl.nattr;
+	f->node[f->nnode].attr = f->nattr;
+	f->ntext = fl.ntext;
+	return f;
+}
+
+void
+xmlflatfree(Xflat *f)
+{
+	if(f == nil)
+		return;
+	free(f->node);
+	free(f->attr);
+	free(f->text);
+	free(f);
+}
+
+/*
+ * pcdata of node n, or nil
+ */
+char *
+xmlflattext(Xflat *f, int n)
+{
+	if(f->node[n].text < 0)
+		return nil;
+	return f->text + f->node[n].text;
+}
+
+/*
+ * value of node n's attribute called name, or nil
+ */
+char *
+xmlflatvalue(Xflat *f, int n, char *name)
+{
+	int atom;
+	Xattr *ap, *ep;
+
+	if((atom = _Xatomn(name, strlen(name))) == -1)
+		return nil;
+	ap = &f->attr[f->node[n].attr];
+	for(ep = &f->attr[f->node[n+1].attr]; ap < ep; ap++)
+		if(ap->atom == atom){
+			if(ap->value < 0)
+				return nil;
+			return f->text + ap->value;
+		}
+	return nil;
+}
+
+/*
+ * Iteration over the nodes below n in document order.
+ * Going down is one step to the following node and going
+ * on is the next sibling of the deepest node that has one,
+ * so no stack is needed.
+ *
+ *	xmliter(&it, f, n);
+ *	while((m = xmliternext(&it)) != 0)
+ *		...
+ */
+void
+xmliter(Xiter *it, Xflat *f, int n)
+{
+	it->f = f;
+	it->top = n;
+	it->node = n;
+	it->depth = 0;
+	it->skip = 0;
+}
+
+/*
+ * the next node, 0 at the end. it->depth is its depth
+ * below the top, 1 for the top's children.
+ */
+int
+xmliternext(Xiter *it)
+{
+	int n;
+	Xnode *node;
+
+	node = it->f->node;
+	n = it->node;
+	if(! it->skip && node[n].child){
+		it->depth++;
+		return it->node = node[n].child;
+	}
+	for(; n != it->top; n = node[n].parent, it->depth--)
+		if(node[n].next){
+			it->skip = 0;
+			return it->node = node[n].next;
+		}
+	/* stay at the end */
+	it->node = n;
+	it->skip = 1;
+	return 0;
+}
+
+/*
+ * don't go below the node just returned
+ */
+void
+xmliterskip(Xiter *it)
+{
+	it->skip = 1;
+}
@@ -4,20 +4,97 @@
 
 #define Roundup(x, g)	(((x) + (unsigned)(g-1)) & ~((unsigned)(g-1)))
 
-struct Xtree {
-	Xtree *left;
-	Xtree *right;
-	char *str;
-	int hits;
+/*
+ * Names are interned in one process-wide hash table so
+ * that each distinct name is stored once and has a small
+ * integer atom which is the same in every Xml; callers can
+ * learn the atoms they care about before parsing anything.
+ * Atoms start at 1, 0 means no name.
+ *
+ * The table only grows: a name stays until xmlatomreset,
+ * since any tree, Xpath, Xmatch or caller may hold its
+ * atom or point at its string. A program that reads
+ * documents with few names in common, one after another,
+ * should call it between them.
+ */
+enum {
+	Maxblock = 1024*1024,	/* biggest block grown to */
+	Nvals = 4096,		/* values interned, a power of two */
+	Maxval = 16,		/* longest value interned */
 };
 
+typedef struct Xname Xname;
+struct Xname {
+	Xname *next;		/* hash chain */
+	int atom;
+	int prefix;		/* atom of the part before a ':', or 0 */
+	int local;		/* atom of the part after, or atom */
+	char str[1];		/* name, allocated to fit */
+};
+
+static struct {
+	Lock;
+	Xname **hash;		/* chains */
+	int nhash;		/* size of hash, a power of two */
+	Xname **atoms;		/* atom to name */
+	int natom;		/* atoms issued so far */
+	int maxatom;		/* size of atoms */
+} Names;
+
+/*
+ * Attribute values under Fintern. Short ones are kept in a
+ * second process-wide table, beside the names, so every
+ * "single" in every tree parsed with the flag is the same
+ * pointer. The table is bounded: it takes the first Nvals
+ * values seen, and later new ones are copied to the arena
+ * as without the flag, so a sheet of unique numbers can't
+ * grow it. Slots are filled once and not changed until
+ * xmlatomreset, so lookups that hit don't lock.
+ */
+static struct {
+	Lock;
+	char *tab[2*Nvals];	/* open addressed, half full at most */
+	int n;
+} Vals;
+
 struct Xblock {
 	Xblock *next;
+	Xalloc *a;		/* where it came from, nil for malloc */
 	char *free;
 	char *end;
 };
 
-static int Strdups, Commons, Unique, Memblocks;
+
+/*
+ * Blocks start at the size given to xmlnew and double, up
+ * to Maxblock, each time another is needed so big documents
+ * need few of them. Objects bigger than a quarter of the
+ * first block get a block to themselves.
+ *
+ * If xp's Xalloc has no room the block comes from malloc
+ * instead and xp->nomem is set: callers of the arena never
+ * see nil, the parser notices and fails, and xmlreset gives
+ * such blocks back.
+ */
+static Xblock *
+newblock(Xml *xp, int sz)
+{
+	Xblock *b;
+	Xalloc *a;
+
+	a = xp->alloc.a;
+	b = nil;
+	if(a && (b = a->alloc(a, sizeof(Xblock) + sz)) == nil){
+		xp->nomem = 1;
+		a = nil;
+	}
+	if(b == nil && (b = mallocz(sizeof(Xblock) + sz, 0)) == nil)
+		sysfatal("store: no memory for %d bytes\n", sz);
+	b->a = a;
+	b->free = (char *)&b[1];
+	b->end = (char *)&b->free[sz];
+	return b;
+}
 
 static void *
 getmem(Xml *xp, int len)
@@ -26,20 +103,34 @@ getmem(Xml *xp, int len)
 	Xblock *b;
 	char *ret;
 
+	if(len < 0)
+		sysfatal("store: bad size %d\n", len);
+	xp->stats.allocs++;
+	xp->stats.requested += len;
+	xp->stats.wasted += Roundup(len, sizeof(long long)) - len;
 	len = Roundup(len, sizeof(long long));
 
-	sz = xp->alloc.blksiz;		/* shorthand */
-	b = xp->alloc.active;
-
-	if(len > sz)
-		sysfatal("store: object too big (%d > %d)\n", len, sz);
-
-	if(xp->alloc.active == nil || b->free + len >= b->end){
-		Memblocks++;
-		b = mallocz(sizeof(Xblock) + sz, 0);
-		b->free = (char *)&b[1];
-		b->end = (char *)&b->free[sz];
+	if(len > xp->alloc.blksiz/4){
+		b = newblock(xp, len);
+		b->free = b->end;
+		b->next = xp->alloc.large;
+		xp->alloc.large = b;
+		return &b[1];
+	}
 
+	b = xp->alloc.active;
+	if(b == nil || b->free + len > b->end){
+		if((b = xp->alloc.spare) != nil)
+			xp->alloc.spare = b->next;
+		else{
+			sz = xp->alloc.blksiz;
+			if(xp->alloc.active){
+				sz = (xp->alloc.active->end - (char *)&xp->alloc.active[1]) * 2;
+				if(sz > Maxblock)
+					sz = Maxblock;
+			}
+			b = newblock(xp, sz);
+		}
 		b->next = xp->alloc.active;
 		xp->alloc.active = b;
 	}
@@ -49,46 +140,281 @@ getmem(Xml *xp, int len)
 	return ret;
 }
 
-static Xtree *
-lookadd(Xml *xp, Xtree *t, char *str, Xtree **match)
+static uint
+hash(char *s, int n)
+{
+	uint h;
+
+	h = 0;
+	while(n-- > 0)
+		h = h*31 + *(uchar *)s++;
+	return h;
+}
+
+static void
+rehash(void)
+{
+	int i, n;
+	uint b;
+	Xname *np, **h;
+
+	n = Names.nhash? Names.nhash*2: 256;
+	if((h = mallocz(n * sizeof(Xname *), 1)) == nil)
+		sysfatal("no memory for name table\n");
+	for(i = 1; i <= Names.natom; i++){
+		np = Names.atoms[i];
+		b = hash(np->str, strlen(np->str)) & (n-1);
+		np->next = h[b];
+		h[b] = np;
+	}
+	free(Names.hash);
+	Names.hash = h;
+	Names.nhash = n;
+}
+
+/*
+ * find the first n bytes of str in the name table,
+ * adding it if add is set. Called with Names locked.
+ */
+static Xname *
+looknm(char *str, int n, int add)
+{
+	uint h;
+	char *p;
+	Xname *np;
+
+	if(Names.nhash){
+		h = hash(str, n) & (Names.nhash-1);
+		for(np = Names.hash[h]; np; np = np->next)
+			if(strncmp(np->str, str, n) == 0 && np->str[n] == 0)
+				return np;
+	}
+	if(! add)
+		return nil;
+
+	if(Names.natom+1 >= Names.maxatom){
+		Names.maxatom = Names.maxatom? Names.maxatom*2: 256;
+		Names.atoms = realloc(Names.atoms, Names.maxatom * sizeof(Xname *));
+		if(Names.atoms == nil)
+			sysfatal("no memory for atom table\n");
+	}
+	if(Names.natom >= Names.nhash)
+		rehash();
+
+	if((np = malloc(sizeof(Xname) + n)) == nil)
+		sysfatal("no memory for name\n");
+	memmove(np->str, str, n);
+	np->str[n] = 0;
+	np->atom = ++Names.natom;
+	Names.atoms[np->atom] = np;
+	h = hash(str, n) & (Names.nhash-1);
+	np->next = Names.hash[h];
+	Names.hash[h] = np;
+
+	np->prefix = 0;
+	np->local = np->atom;
+	if((p = strrchr(np->str, ':')) != nil && p > np->str && p[1] != 0){
+		np->prefix = looknm(np->str, p - np->str, 1)->atom;
+		np->local = looknm(p+1, strlen(p+1), 1)->atom;
+	}
+	return np;
+}
+
+/*
+ * intern str, returning the shared copy and its atom;
+ * the lookup is counted in xp's stats if xp isn't nil.
+ */
+char *
+_Xintern(Xml *xp, char *str, int *atomp)
+{
+	return _Xinternq(xp, str, atomp, nil, nil, nil);
+}
+
+/*
+ * _Xintern, also giving the atoms of the prefix and the
+ * local part of a qualified name like w:p, and the local
+ * part's shared copy; the prefix is 0 and the local part
+ * the name itself if there is no ':'.
+ */
+char *
+_Xinternq(Xml *xp, char *str, int *atomp, int *prefixp, int *localp, char **lnamep)
 {
 	int n;
+	Xname *np;
 
-	if(t == nil){
-		Unique++;
-		t = getmem(xp, sizeof(Xtree) + strlen(str)+1);
-		t->left = nil;
-		t->right = nil;
-		t->str = (char *)&t[1];
-		strcpy(t->str, str);
-		*match = t;
-		t->hits = 1;
-		return t;
+	lock(&Names);
+	n = Names.natom;
+	np = looknm(str, strlen(str), 1);
+	if(xp){
+		xp->stats.lookups++;
+		if(n == Names.natom)
+			xp->stats.hits++;
 	}
+	if(lnamep)
+		*lnamep = Names.atoms[np->local]->str;
+	unlock(&Names);
+	if(atomp)
+		*atomp = np->atom;
+	if(prefixp)
+		*prefixp = np->prefix;
+	if(localp)
+		*localp = np->local;
+	return np->str;
+}
 
-	if((n = strcmp(str, t->str)) == 0){
-		*match = t;
-		t->hits++;
+/*
+ * the atom for the first n bytes of str, or -1
+ * if no such name has been seen.
+ */
+int
+_Xatomn(char *str, int n)
+{
+	Xname *np;
+
+	lock(&Names);
+	np = looknm(str, n, 0);
+	unlock(&Names);
+	if(np == nil)
+		return -1;
+	return np->atom;
+}
+
+int
+xmlatom(char *name)
+{
+	int atom;
+
+	_Xintern(nil, name, &atom);
+	return atom;
+}
+
+char *
+xmlatomname(int atom)
+{
+	char *s;
+
+	s = nil;
+	lock(&Names);
+	if(atom > 0 && atom <= Names.natom)
+		s = Names.atoms[atom]->str;
+	unlock(&Names);
+	return s;
+}
+
+/*
+ * the shared copy of the n bytes at str, adding it if
+ * there is room, or nil if it is too long or the table
+ * is full.
+ */
+static char *
+lookval(char *str, int n)
+{
+	uint h, i;
+	char *s;
+
+	if(n > Maxval)
+		return nil;
+	h = hash(str, n);
+	for(i = h;; i++){
+		s = Vals.tab[i & (2*Nvals-1)];
+		if(s == nil)
+			break;
+		if(strncmp(s, str, n) == 0 && s[n] == 0)
+			return s;
+	}
+
+	lock(&Vals);
+	for(i = h;; i++){
+		s = Vals.tab[i & (2*Nvals-1)];
+		if(s == nil)
+			break;
+		if(strncmp(s, str, n) == 0 && s[n] == 0){
+			unlock(&Vals);
+			return s;
+		}
+	}
+	if(Vals.n >= Nvals){
+		unlock(&Vals);
+		return nil;
 	}
-	if(n < 0)
-		t->left = lookadd(xp, t->left, str, match);
-	if(n > 0)
-		t->right = lookadd(xp, t->right, str, match);
-	return t;
+	if((s = malloc(n+1)) == nil)
+		sysfatal("no memory for value\n");
+	memmove(s, str, n);
+	s[n] = 0;
+	coherence();
+	Vals.tab[i & (2*Nvals-1)] = s;
+	Vals.n++;
+	unlock(&Vals);
+	return s;
 }
 
+/*
+ * val for an attribute parsed under Fintern, the shared
+ * copy if there is one, or nil; counted in xp's stats.
+ */
 char *
-xmlstrdup(Xml *xp, char *str, int iscommon)
+_Xinternval(Xml *xp, char *val)
 {
 	char *s;
-	Xtree *t;
 
-	Strdups++;
-	if(iscommon){
-		Commons++;
-		xp->alloc.root = lookadd(xp, xp->alloc.root, str, &t);
-		return t->str;
+	if((s = lookval(val, strlen(val))) != nil)
+		xp->stats.shared++;
+	return s;
+}
+
+/*
+ * the copy of str that trees parsed with Fintern use for
+ * attribute values equal to it, so they can be compared
+ * with ==; nil if str is longer than Maxval or the table
+ * is full, when values must be compared with strcmp.
+ * Trees loaded with xmlsnapload hold their own copies.
+ */
+char *
+xmlintern(char *str)
+{
+	return lookval(str, strlen(str));
+}
+
+/*
+ * forget every name, atom and interned value. Only for
+ * when nothing made since the last reset is left: every
+ * Xml, Xflat, Xpath and Xmatch must have been freed and
+ * atoms and values kept by the caller must be looked up
+ * again.
+ */
+void
+xmlatomreset(void)
+{
+	int i;
+
+	lock(&Names);
+	for(i = 1; i <= Names.natom; i++)
+		free(Names.atoms[i]);
+	free(Names.atoms);
+	free(Names.hash);
+	Names.atoms = nil;
+	Names.hash = nil;
+	Names.natom = 0;
+	Names.maxatom = 0;
+	Names.nhash = 0;
+	unlock(&Names);
+
+	lock(&Vals);
+	for(i = 0; i < nelem(Vals.tab); i++){
+		free(Vals.tab[i]);
+		Vals.tab[i] = nil;
 	}
+	Vals.n = 0;
+	unlock(&Vals);
+}
+
+char *
+xmlstrdup(Xml *xp, char *str, int iscommon)
+{
+	char *s;
+
+	if(iscommon)
+		return _Xintern(xp, str, nil);
 
 	s = getmem(xp, strlen(str)+1);
 	return strcpy(s, str);
@@ -99,6 +425,8 @@ xmlcalloc(Xml *xp, int n, int m)
 {
 	void *v;
 
+	if(n < 0 || m < 0 || m > 0 && n > 0x7fffffff/m)
+		sysfatal("xmlcalloc: %d×%d bytes\n", n, m);
 	v = getmem(xp, n * m);
 	memset(v, 0, n * m);
 	return v;
@@ -112,23 +440,142 @@ xmlmalloc(Xml *xp, int n)
 
 
 void
-_Xheapstats(void)
+_Xheapstats(Xml *xp)
+{
+	int n;
+	Xstats s;
+
+	lock(&Names);
+	n = Names.natom;
+	unlock(&Names);
+	xmlstats(xp, &s);
+	fprint(2, "names=%d lookups=%d hits=%d requested=%lld wasted=%lld blocks=%d\n",
+		n, s.lookups, s.hits, s.requested, s.wasted, s.blocks);
+}
+
+static void
+freeblocks(Xml *xp, Xblock *b)
 {
-	fprint(2, "total=%d common=%d -> unique=%d rare=%d memblocks=%d\n",
-		Strdups, Commons, Unique, Strdups - Commons, Memblocks);
+	Xblock *n;
+
+	for(; b; b = n){
+		n = b->next;
+		if(xp->debug)
+			memset(&b[1], 0x7e, b->end - (char *)&b[1]);
+		if(b->a)
+			b->a->free(b->a, b, b->end - (char *)b);
+		else
+			free(b);
+	}
 }
 
 void
 _Xheapfree(Xml *xp)
 {
-	Xblock *b, *n;
+	freeblocks(xp, xp->alloc.active);
+	freeblocks(xp, xp->alloc.large);
+	freeblocks(xp, xp->alloc.spare);
+	xp->alloc.active = nil;
+	xp->alloc.large = nil;
+	xp->alloc.spare = nil;
+}
+
+/*
+ * empty xp so that it may be used again, its blocks are
+ * kept for reuse, only large objects and those malloc'd
+ * when xp's Xalloc was full are given back.
+ */
+void
+xmlreset(Xml *xp)
+{
+	Xblock *b, *n, **l, *gone;
 
+	gone = xp->alloc.large;
+	l = &xp->alloc.spare;
 	for(b = xp->alloc.active; b; b = n){
 		n = b->next;
-		if(xmldebug)
-			memset(b, 0x7e, xp->alloc.blksiz);
-		free(b);
+		if(b->a != xp->alloc.a){
+			b->next = gone;
+			gone = b;
+			continue;
+		}
+		b->free = (char *)&b[1];
+		if(xp->debug)
+			memset(b->free, 0x7e, b->end - b->free);
+		b->next = *l;
+		*l = b;
 	}
+	xp->alloc.active = nil;
 
+	freeblocks(xp, gone);
+	xp->alloc.large = nil;
+	xp->nomem = 0;
+
+	xp->root = nil;
+	xp->doctype = nil;
+	free(xp->src);
+	xp->src = nil;
+	memset(&xp->stats, 0, sizeof(Xstats));
 }
 
+static void
+append(Xblock **dst, Xblock *src)
+{
+	Xblock *b;
+
+	if(src == nil)
+		return;
+	for(b = src; b->next; b = b->next)
+		;
+	b->next = *dst;
+	*dst = src;
+}
+
+/*
+ * move src's blocks, and their share of the stats, to dst,
+ * leaving src empty; dst keeps allocating from its own
+ * active block. Both must get their memory from the same
+ * place, see xmlnewalloc.
+ */
+void
+_Xheapjoin(Xml *dst, Xml *src)
+{
+	if(dst->alloc.active)
+		append(&dst->alloc.active->next, src->alloc.active);
+	else
+		dst->alloc.active = src->alloc.active;
+	append(&dst->alloc.large, src->alloc.large);
+	append(&dst->alloc.spare, src->alloc.spare);
+	dst->stats.requested += src->stats.requested;
+	dst->stats.wasted += src->stats.wasted;
+	dst->stats.allocs += src->stats.allocs;
+	dst->nomem |= src->nomem;
+	src->stats.requested = 0;
+	src->stats.wasted = 0;
+	src->stats.allocs = 0;
+	src->alloc.active = nil;
+	src->alloc.large = nil;
+	src->alloc.spare = nil;
+}
+
+/*
+ * a copy of xp's stats, with the figures that depend on
+ * the state of the arena filled in.
+ */
+void
+xmlstats(Xml *xp, Xstats *sp)
+{
+	Xblock *b;
+
+	*sp = xp->stats;
+	for(b = xp->alloc.active; b; b = b->next){
+		sp->blocks++;
+		if(b != xp->alloc.active)
+			sp->wasted += b->end - b->free;
+	}
+	for(b = xp->alloc.large; b; b = b->next)
+		sp->blocks++;
+	sp->hitrate = 0.0;
+	if(sp->lookups)
+		sp->hitrate = (double)sp->hits / sp->lookups;
+}
@@ -0,0 +1,103 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Find the first byte in [p, e) the lexer must look at:
+ * c1, c2, NUL, or the start of a multibyte UTF-8 sequence.
+ *
+ * Plain text is tested eight bytes at a time using the usual
+ * "has a zero byte" trick: (v - 0x01..01) & ~v & 0x80..80 is
+ * non-zero iff some byte of v is zero, and v^(c*0x01..01) has
+ * a zero byte wherever v holds c. Bytes with the top bit set
+ * are caught by the same 0x80..80 mask.
+ */
+
+#define Lo	0x0101010101010101ULL
+#define Hi	0x8080808080808080ULL
+#define Haszero(v)	(((v) - Lo) & ~(v) & Hi)
+
+uchar *
+_Xscan(uchar *p, uchar *e, int c1, int c2)
+{
+	uvlong v, m1, m2;
+
+	while(p < e && ((uintptr)p & (sizeof(uvlong)-1)) != 0){
+		if(*p == c1 || *p == c2 || *p == 0 || *p >= Runeself)
+			return p;
+		p++;
+	}
+
+	m1 = Lo * (uchar)c1;
+	m2 = Lo * (uchar)c2;
+	for(; p + sizeof(uvlong) <= e; p += sizeof(uvlong)){
+		v = *(uvlong *)p;
+		if(((v & Hi) | Haszero(v) | Haszero(v ^ m1) | Haszero(v ^ m2)) != 0)
+			break;
+	}
+
+	for(; p < e; p++)
+		if(*p == c1 || *p == c2 || *p == 0 || *p >= Runeself)
+			break;
+	return p;
+}
+
+/*
+ * the first byte in [p, e) that xmlprint must escape: a
+ * control character or one of & < > " '. The same trick
+ * finds bytes below 0x20: (v - 0x20..20) & ~v & 0x80..80.
+ */
+#define Hasless(v, n)	(((v) - Lo*(n)) & ~(v) & Hi)
+#define Isesc(c)	((c) < ' ' || (c) == '&' || (c) == '<' || (c) == '>' || (c) == '"' || (c) == '\'')
+
+uchar *
+_Xscanesc(uchar *p, uchar *e)
+{
+	uvlong v;
+
+	while(p < e && ((uintptr)p & (sizeof(uvlong)-1)) != 0){
+		if(Isesc(*p))
+			return p;
+		p++;
+	}
+
+	for(; p + sizeof(uvlong) <= e; p += sizeof(uvlong)){
+		v = *(uvlong *)p;
+		if((Hasless(v, ' ') | Haszero(v ^ Lo*'&') | Haszero(v ^ Lo*'<') |
+		    Haszero(v ^ Lo*'>') | Haszero(v ^ Lo*'"') | Haszero(v ^ Lo*'\'')) != 0)
+			break;
+	}
+
+	for(; p < e; p++)
+		if(Isesc(*p))
+			break;
+	return p;
+}
+
+/*
+ * the first byte in [p, e) that doesn't start a whole, well
+ * formed UTF-8 sequence, or e. ASCII is passed over eight
+ * bytes at a time, anything else is checked by chartorune
+ * so it agrees with the parser's own decoding.
+ */
+uchar *
+_Xutf(uchar *p, uchar *e)
+{
+	int n;
+	Rune r;
+
+	for(;;){
+		while(p < e && *p < Runeself){
+			p++;
+			if(((uintptr)p & (sizeof(uvlong)-1)) == 0)
+				while(p + sizeof(uvlong) <= e && (*(uvlong *)p & Hi) == 0)
+					p += sizeof(uvlong);
+		}
+		if(p >= e || ! fullrune((char *)p, e-p))
+			return p;
+		n = chartorune(&r, (char *)p);
+		if(r == Runeerror && n == 1)
+			return p;
+		p += n;
+	}
+}
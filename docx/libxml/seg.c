@@ -0,0 +1,173 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * An Xalloc handing out arena blocks from one segment
+ * attached with segattach(2), for xmlnewalloc. The class
+ * picks the memory, "memory" for ordinary pages or one the
+ * kernel offers for big pages, and the size is fixed when
+ * it is made, so an Xml using it never grows past it.
+ * Blocks are cut off the front of what is left; freed ones
+ * go on a list, merged with any free space next to them,
+ * and are used first fit. When the last block in use is
+ * given back the pages are returned to the kernel with
+ * segfree and cutting starts again from the bottom, so a
+ * batch of documents parsed and freed one after another
+ * can share it without it filling up.
+ */
+
+#define Roundup(x, g)	(((x) + (g)-1) & ~((ulong)(g)-1))
+
+enum {
+	Pagesize = 4096,
+	Align = 64,		/* of blocks, and so of holes */
+};
+
+typedef struct Hole Hole;
+struct Hole {
+	Hole	*next;
+	ulong	n;
+};
+
+typedef struct Seg Seg;
+struct Seg {
+	Lock;
+	uchar	*base;
+	uchar	*top;		/* of blocks cut so far */
+	uchar	*used;		/* highest top since the pages were freed */
+	uchar	*end;
+	Hole	*holes;		/* free space below top, in address order */
+	int	nused;		/* blocks out */
+};
+
+static void *
+segalloc(Xalloc *a, ulong n)
+{
+	Seg *s;
+	Hole *h, *nh, **l;
+	void *p;
+
+	s = a->aux;
+	n = Roundup(n, Align);
+	lock(s);
+	for(l = &s->holes; (h = *l) != nil; l = &h->next)
+		if(h->n >= n){
+			*l = h->next;
+			if(h->n > n){
+				nh = (Hole *)((uchar *)h + n);
+				nh->n = h->n - n;
+				nh->next = *l;
+				*l = nh;
+			}
+			p = h;
+			goto Out;
+		}
+	if(n > s->end - s->top){
+		unlock(s);
+		werrstr("segment full");
+		return nil;
+	}
+	p = s->top;
+	s->top += n;
+	if(s->top > s->used)
+		s->used = s->top;
+Out:
+	s->nused++;
+	unlock(s);
+	return p;
+}
+
+/*
+ * holes are kept in address order and merged with their
+ * neighbours as they are made; one that reaches top is
+ * given back to the space above it.
+ */
+static void
+segrelease(Xalloc *a, void *p, ulong n)
+{
+	Seg *s;
+	Hole *h, *nh, **l, **pl;
+
+	s = a->aux;
+	lock(s);
+	pl = nil;
+	for(l = &s->holes; *l && (uchar *)*l < (uchar *)p; l = &(*l)->next)
+		pl = l;
+	h = p;
+	h->n = Roundup(n, Align);
+	h->next = *l;
+	*l = h;
+	if((nh = h->next) != nil && (uchar *)h + h->n == (uchar *)nh){
+		h->n += nh->n;
+		h->next = nh->next;
+	}
+	if(pl && (uchar *)*pl + (*pl)->n == (uchar *)h){
+		(*pl)->n += h->n;
+		(*pl)->next = h->next;
+		h = *pl;
+		l = pl;
+	}
+	if((uchar *)h + h->n == s->top){
+		s->top = (uchar *)h;
+		*l = nil;
+	}
+	if(--s->nused == 0){
+		segfree(s->base, Roundup(s->used - s->base, Pagesize));
+		s->top = s->base;
+		s->used = s->base;
+		s->holes = nil;
+	}
+	unlock(s);
+}
+
+/*
+ * an Xalloc backed by a segment of class, "memory" if nil,
+ * len bytes long. nil if it can't be attached.
+ */
+Xalloc *
+xmlsegalloc(char *class, ulong len)
+{
+	Xalloc *a;
+	Seg *s;
+	void *va;
+
+	if(class == nil)
+		class = "memory";
+	len = Roundup(len, Pagesize);
+	if((va = segattach(0, class, nil, len)) == (void *)-1)
+		return nil;
+	a = mallocz(sizeof(Xalloc), 1);
+	s = mallocz(sizeof(Seg), 1);
+	if(a == nil || s == nil){
+		free(a);
+		free(s);
+		segdetach(va);
+		return nil;
+	}
+	s->base = va;
+	s->top = va;
+	s->used = va;
+	s->end = s->base + len;
+	a->aux = s;
+	a->alloc = segalloc;
+	a->free = segrelease;
+	return a;
+}
+
+/*
+ * detach a's segment, every Xml using it must have been
+ * freed first
+ */
+void
+xmlsegfree(Xalloc *a)
+{
+	Seg *s;
+
+	if(a == nil)
+		return;
+	s = a->aux;
+	segdetach(s->base);
+	free(s);
+	free(a);
+}
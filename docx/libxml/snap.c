@@ -0,0 +1,377 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * A parsed tree saved to a file, so a part that is read
+ * again and again need only be parsed once. Nothing in
+ * the file is a pointer: elements are stored in document
+ * order, each says how many elements its subtree holds so
+ * the next sibling is found that far on and the first
+ * child is the one after; attributes follow in order and
+ * each element says how many are its own; strings are
+ * offsets into one block of text and names are indices
+ * into a table of them. All numbers are 4 bytes, little
+ * endian.
+ *
+ *	header	magic, nelem, nattr, nname, ntext, doctype, maxdepth
+ *	names	nname text offsets
+ *	elems	nelem × (size, flags, name, ns, nattr, pcdata, line)
+ *	attrs	nattr × (name, ns, value)
+ *	text	ntext bytes of NUL terminated strings
+ *
+ * Element and attribute names are indices into names,
+ * from 1, as are namespace URIs, for which 0 is none.
+ * Pcdata, values and the doctype are a text offset plus
+ * one, 0 is nil.
+ */
+
+#define Magic	"xmlsnap2"
+
+#define G32(p)	((p)[0] | (p)[1]<<8 | (p)[2]<<16 | (ulong)(p)[3]<<24)
+
+enum {
+	Hdrlen = 8 + 6*4,
+	Elemlen = 7*4,
+	Attrlen = 3*4,
+
+	Maxload = 0x7fffffff/4,	/* most bytes of anything xmlsnapload makes */
+
+	Fchild = 1,		/* element has children */
+	Fnext = 2,		/* element has a next sibling */
+};
+
+typedef struct Buf Buf;
+struct Buf {
+	uchar	*p;
+	long	n;
+	long	max;
+};
+
+typedef struct Snap Snap;
+struct Snap {
+	Buf	names;
+	Buf	elems;
+	Buf	attrs;
+	Buf	text;
+	int	nelem;
+	int	nattr;
+	int	nname;
+	int	*idx;			/* atom to name index */
+	int	maxidx;
+	int	maxdepth;
+};
+
+static void
+grow(Buf *b, long n)
+{
+	if(b->n + n <= b->max)
+		return;
+	b->max = b->max? b->max*2: 8192;
+	if(b->max < b->n + n)
+		b->max = b->n + n;
+	if((b->p = realloc(b->p, b->max)) == nil)
+		sysfatal("xmlsnapshot: no memory\n");
+}
+
+static void
+put32(Buf *b, ulong v)
+{
+	grow(b, 4);
+	b->p[b->n++] = v;
+	b->p[b->n++] = v>>8;
+	b->p[b->n++] = v>>16;
+	b->p[b->n++] = v>>24;
+}
+
+/*
+ * text offset of a copy of s, plus one; 0 for nil
+ */
+static ulong
+puttext(Snap *s, char *str)
+{
+	long n, off;
+
+	if(str == nil)
+		return 0;
+	n = strlen(str)+1;
+	grow(&s->text, n);
+	off = s->text.n;
+	memmove(s->text.p+off, str, n);
+	s->text.n += n;
+	return off+1;
+}
+
+static ulong
+putname(Snap *s, char *name, int atom)
+{
+	int n;
+
+	if(name == nil || atom <= 0)
+		return 0;
+	if(atom >= s->maxidx){
+		n = s->maxidx;
+		s->maxidx = atom*2;
+		if((s->idx = realloc(s->idx, s->maxidx * sizeof(int))) == nil)
+			sysfatal("xmlsnapshot: no memory\n");
+		memset(s->idx+n, 0, (s->maxidx-n) * sizeof(int));
+	}
+	if(s->idx[atom] == 0){
+		s->idx[atom] = ++s->nname;
+		put32(&s->names, puttext(s, name)-1);
+	}
+	return s->idx[atom];
+}
+
+/*
+ * add ep and its subtree, returns how many elements that was
+ */
+static int
+putelem(Snap *s, Elem *ep, int depth)
+{
+	int n, nattr, flags;
+	long rec;
+	Attr *ap;
+	Elem *cp;
+
+	if(depth > s->maxdepth)
+		s->maxdepth = depth;
+	nattr = 0;
+	for(ap = ep->attrs; ap; ap = ap->next){
+		put32(&s->attrs, putname(s, ap->name, ap->atom));
+		put32(&s->attrs, putname(s, xmlatomname(ap->ns), ap->ns));
+		put32(&s->attrs, puttext(s, ap->value));
+		nattr++;
+	}
+	s->nattr += nattr;
+	s->nelem++;
+
+	flags = 0;
+	if(xmlchild(ep))
+		flags |= Fchild;
+	if(ep->next)
+		flags |= Fnext;
+	rec = s->elems.n;
+	put32(&s->elems, 0);		/* size, filled in below */
+	put32(&s->elems, flags);
+	put32(&s->elems, putname(s, ep->name, ep->atom));
+	put32(&s->elems, putname(s, xmlatomname(ep->ns), ep->ns));
+	put32(&s->elems, nattr);
+	put32(&s->elems, puttext(s, ep->pcdata));
+	put32(&s->elems, ep->line);
+
+	n = 1;
+	for(cp = ep->child; cp; cp = cp->next)
+		n += putelem(s, cp, depth+1);
+	s->elems.p[rec] = n;
+	s->elems.p[rec+1] = n>>8;
+	s->elems.p[rec+2] = n>>16;
+	s->elems.p[rec+3] = n>>24;
+	return n;
+}
+
+/*
+ * write xp's tree to fd for xmlsnapload
+ */
+int
+xmlsnapshot(Xml *xp, int fd)
+{
+	int rc;
+	ulong doctype;
+	Elem *ep;
+	Snap s;
+	Buf hdr;
+
+	memset(&s, 0, sizeof(s));
+	memset(&hdr, 0, sizeof(hdr));
+	for(ep = xp->root; ep; ep = ep->next)
+		putelem(&s, ep, 1);
+	doctype = puttext(&s, xp->doctype);
+
+	grow(&hdr, Hdrlen);
+	memmove(hdr.p, Magic, 8);
+	hdr.n = 8;
+	put32(&hdr, s.nelem);
+	put32(&hdr, s.nattr);
+	put32(&hdr, s.nname);
+	put32(&hdr, s.text.n);
+	put32(&hdr, doctype);
+	put32(&hdr, s.maxdepth);
+
+	rc = 0;
+	if(write(fd, hdr.p, hdr.n) != hdr.n
+	|| write(fd, s.names.p, s.names.n) != s.names.n
+	|| write(fd, s.elems.p, s.elems.n) != s.elems.n
+	|| write(fd, s.attrs.p, s.attrs.n) != s.attrs.n
+	|| write(fd, s.text.p, s.text.n) != s.text.n)
+		rc = -1;
+
+	free(hdr.p);
+	free(s.names.p);
+	free(s.elems.p);
+	free(s.attrs.p);
+	free(s.text.p);
+	free(s.idx);
+	return rc;
+}
+
+static char *
+text(char *base, long ntext, ulong off)
+{
+	if(off == 0)
+		return nil;
+	if(off > ntext)
+		return (char *)-1;
+	return base + off-1;
+}
+
+static Xml *
+bad(Xml *xp, uchar *buf, char *why)
+{
+	werrstr("xmlsnapload: %s", why);
+	free(buf);
+	xmlfree(xp);
+	return nil;
+}
+
+/*
+ * rebuild a tree written by xmlsnapshot. The text is read
+ * straight into the arena and used where it lies, names
+ * are interned again since atoms differ between processes.
+ * The result is an ordinary Xml, for xmlfree when done.
+ * The counts in the header are checked against what is
+ * left of the file before anything is allocated, so a
+ * damaged or hostile one is refused rather than trusted.
+ */
+Xml *
+xmlsnapload(int fd, int blksize)
+{
+	int i, n, nelem, nattr, nname, ntext, a;
+	long len;
+	vlong left;
+	ulong v;
+	uchar hdr[Hdrlen], *buf, *p, *q;
+	char *txt, **name, *s;
+	int *atoms, *local;
+	Dir *d;
+	Xml *xp;
+	Elem *e, *ep, *cp;
+	Attr *at, *ap;
+
+	if((d = dirfstat(fd)) == nil)
+		return nil;
+	left = d->length - seek(fd, 0, 1);
+	free(d);
+	if((xp = xmlnew(blksize)) == nil)
+		return nil;
+	buf = nil;
+	if(readn(fd, hdr, Hdrlen) != Hdrlen || memcmp(hdr, Magic, 8) != 0)
+		return bad(xp, buf, "not a snapshot");
+	left -= Hdrlen;
+	nelem = G32(hdr+8);
+	nattr = G32(hdr+12);
+	nname = G32(hdr+16);
+	ntext = G32(hdr+20);
+	if(nelem < 0 || nattr < 0 || nname < 0 || ntext < 0)
+		return bad(xp, buf, "bad header");
+	if((vlong)nname*4 + (vlong)nelem*Elemlen + (vlong)nattr*Attrlen + ntext > left)
+		return bad(xp, buf, "short file");
+	if((vlong)nelem*sizeof(Elem) > Maxload || (vlong)nattr*sizeof(Attr) > Maxload
+	|| ((vlong)nname+1)*(sizeof(char*) + 2*sizeof(int)) > Maxload || ntext >= Maxload)
+		return bad(xp, buf, "too big");
+
+	len = nname*4 + nelem*Elemlen + nattr*Attrlen;
+	if((buf = malloc(len + (nname+1) * (sizeof(char*) + 2*sizeof(int)))) == nil)
+		return bad(xp, buf, "no memory");
+	txt = xmlmalloc(xp, ntext+1);
+	if(readn(fd, buf, len) != len || readn(fd, txt, ntext) != ntext)
+		return bad(xp, buf, "short file");
+	txt[ntext] = 0;
+
+	name = (char **)(buf + len);
+	atoms = (int *)(name + nname+1);
+	local = atoms + nname+1;
+	name[0] = nil;
+	atoms[0] = 0;
+	local[0] = 0;
+	p = buf;
+	for(i = 1; i <= nname; i++, p += 4){
+		if((v = G32(p)) >= ntext)
+			return bad(xp, buf, "bad name");
+		name[i] = _Xinternq(xp, txt+v, &atoms[i], nil, &local[i], nil);
+	}
+
+	e = xmlcalloc(xp, nelem? nelem: 1, sizeof(Elem));
+	at = xmlcalloc(xp, nattr? nattr: 1, sizeof(Attr));
+	a = 0;
+	q = p + (vlong)nelem*Elemlen;
+	for(i = 0; i < nelem; i++, p += Elemlen){
+		ep = &e[i];
+		n = G32(p);
+		v = G32(p+4);
+		if(n < 1 || n > nelem-i || (v&Fchild) && n < 2 || (v&Fnext) && i+n >= nelem)
+			return bad(xp, buf, "bad element");
+		if(v & Fchild)
+			ep->child = &e[i+1];
+		if(v & Fnext)
+			ep->next = &e[i+n];
+		if((v = G32(p+8)) == 0 || v > nname)
+			return bad(xp, buf, "bad element name");
+		ep->name = name[v];
+		ep->atom = atoms[v];
+		ep->local = local[v];
+		if((v = G32(p+12)) > nname)
+			return bad(xp, buf, "bad namespace");
+		ep->ns = atoms[v];
+		ep->pcdata = text(txt, ntext, G32(p+20));
+		ep->line = G32(p+24);
+		if(ep->pcdata == (char *)-1)
+			return bad(xp, buf, "bad pcdata");
+		if(ep->pcdata)
+			xp->stats.texts++;
+
+		n = G32(p+16);
+		if(n < 0 || n > nattr-a)
+			return bad(xp, buf, "bad attribute count");
+		for(; n > 0; n--, a++, q += Attrlen){
+			ap = &at[a];
+			if((v = G32(q)) == 0 || v > nname)
+				return bad(xp, buf, "bad attribute name");
+			ap->name = name[v];
+			ap->atom = atoms[v];
+			ap->local = local[v];
+			if((v = G32(q+4)) > nname)
+				return bad(xp, buf, "bad namespace");
+			ap->ns = atoms[v];
+			s = text(txt, ntext, G32(q+8));
+			if(s == (char *)-1)
+				return bad(xp, buf, "bad attribute value");
+			ap->value = s;
+			ap->parent = ep;
+			if(n > 1)
+				ap->next = &at[a+1];
+			if(ep->attrs == nil)
+				ep->attrs = ap;
+		}
+	}
+	if(a != nattr)
+		return bad(xp, buf, "attributes left over");
+
+	/* parents come before their children */
+	for(i = 0; i < nelem; i++)
+		for(cp = e[i].child; cp; cp = cp->next)
+			cp->parent = &e[i];
+
+	if(nelem)
+		xp->root = e;
+	xp->doctype = text(txt, ntext, G32(hdr+24));
+	if(xp->doctype == (char *)-1)
+		return bad(xp, buf, "bad doctype");
+	xp->stats.elems = nelem;
+	xp->stats.attrs = nattr;
+	xp->stats.maxdepth = G32(hdr+28);
+	if(xp->nomem)
+		return bad(xp, buf, "out of memory");
+	free(buf);
+	return xp;
+}
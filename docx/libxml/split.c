@@ -0,0 +1,182 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Find places where a document held in memory can be cut
+ * so that the pieces may be parsed independently. A quick
+ * scan that only looks at markup notes every element down
+ * to Maxdepth; the one with the most children (sheetData
+ * or w:body in practice) is chosen and its children are
+ * shared out into pieces of about the same size.
+ */
+
+enum {
+	Maxdepth = 3,		/* deepest element recorded, root is 1 */
+	Minkids = 64,		/* fewer children than this aren't worth it */
+};
+
+typedef struct Tag Tag;
+struct Tag {
+	uchar	*start;		/* the '<' of the start tag */
+	uchar	*end;		/* the '<' of the end tag, or nil */
+	int	parent;		/* index in tags, or -1 */
+	int	nkid;
+};
+
+/*
+ * return the byte after the first s in p..e, or e.
+ */
+static uchar *
+skip(uchar *p, uchar *e, char *s)
+{
+	int n;
+
+	n = strlen(s);
+	for(; (p = memchr(p, s[0], e-p)) != nil; p++)
+		if(e-p >= n && memcmp(p, s, n) == 0)
+			return p+n;
+	return e;
+}
+
+static int
+prescan(uchar *p, uchar *e, Tag **tagp)
+{
+	int depth, ntag, maxtag, empty, stack[Maxdepth];
+	uchar *q, c;
+	Tag *tag, *t;
+
+	depth = 0;
+	ntag = 0;
+	maxtag = 0;
+	tag = nil;
+	for(; (p = memchr(p, '<', e-p)) != nil; ){
+		q = p+1;
+		if(q >= e)
+			break;
+		switch(*q){
+		case '!':
+			if(e-q >= 3 && memcmp(q, "!--", 3) == 0)
+				p = skip(q+3, e, "-->");
+			else if(e-q >= 8 && memcmp(q, "![CDATA[", 8) == 0)
+				p = skip(q+8, e, "]]>");
+			else
+				p = skip(q, e, ">");
+			continue;
+		case '?':
+			p = skip(q, e, ">");
+			continue;
+		case '/':
+			if(--depth < 0)
+				goto bad;
+			if(depth < Maxdepth)
+				tag[stack[depth]].end = p;
+			p = skip(q, e, ">");
+			continue;
+		}
+
+		for(; q < e && *q != '>'; q++)
+			if(*q == '"' || *q == '\''){
+				c = *q++;
+				if((q = memchr(q, c, e-q)) == nil)
+					goto bad;
+			}
+		if(q >= e)
+			goto bad;
+		empty = q[-1] == '/';
+		if(depth < Maxdepth){
+			if(ntag == maxtag){
+				maxtag = maxtag? maxtag*2: 1024;
+				if((tag = realloc(tag, maxtag * sizeof(Tag))) == nil)
+					return -1;
+			}
+			t = &tag[ntag];
+			t->start = p;
+			t->end = nil;
+			t->nkid = 0;
+			t->parent = depth? stack[depth-1]: -1;
+			if(t->parent != -1)
+				tag[t->parent].nkid++;
+			if(! empty)
+				stack[depth] = ntag;
+			ntag++;
+		}
+		if(! empty)
+			depth++;
+		p = q+1;
+	}
+	*tagp = tag;
+	return ntag;
+bad:
+	free(tag);
+	return -1;
+}
+
+/*
+ * fill cut[0..n] with the starts of n pieces and the end
+ * of the last, returns n which is at most ncut and is 0
+ * if the document doesn't split well. Everything before
+ * cut[0] and from cut[n] on belongs to the caller. The
+ * start tags of the pieces' ancestors, outermost first,
+ * go in anc followed by a nil, at most Maxdepth+1 (4)
+ * pointers. p..e may hold the contents of an element
+ * rather than a whole document, then the elements at
+ * its top level may be what is shared out.
+ */
+int
+_Xsplit(uchar *p, uchar *e, uchar **cut, int ncut, uchar **anc)
+{
+	int i, k, n, best, ntag, ntop, nkid;
+	uchar *target, *end;
+	Tag *tag;
+
+	if(ncut < 2 || (ntag = prescan(p, e, &tag)) <= 0)
+		return 0;
+
+	best = -1;
+	ntop = 0;
+	for(i = 0; i < ntag; i++){
+		if(tag[i].parent == -1)
+			ntop++;
+		if(tag[i].end && (best == -1 || tag[i].nkid > tag[best].nkid))
+			best = i;
+	}
+	if(best == -1 || tag[best].nkid < ntop){
+		best = -1;
+		nkid = ntop;
+		end = e;
+	}else{
+		nkid = tag[best].nkid;
+		end = tag[best].end;
+	}
+	if(nkid < Minkids){
+		free(tag);
+		return 0;
+	}
+
+	n = 0;
+	for(i = best+1; i < ntag && tag[i].start < end; i++){
+		if(tag[i].parent != best)
+			continue;
+		if(n == 0){
+			cut[n++] = tag[i].start;
+			continue;
+		}
+		k = end - cut[0];
+		target = cut[0] + (vlong)k * n / ncut;
+		if(tag[i].start >= target && n < ncut)
+			cut[n++] = tag[i].start;
+	}
+	cut[n] = end;
+
+	k = 0;
+	for(i = best; i != -1; i = tag[i].parent)
+		k++;
+	anc[k] = nil;
+	for(i = best; i != -1; i = tag[i].parent)
+		anc[--k] = tag[i].start;
+	free(tag);
+	if(n < 2)
+		return 0;
+	return n;
+}
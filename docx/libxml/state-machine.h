@@ -31,6 +31,7 @@ enum {			/* Parser Actions */
 	Aup	= 6,
 	Adown	= 7,
 	Acheck	= 8,
+	Aempty	= 9,
 	NumActions
 };
 
@@ -56,7 +57,7 @@ actstr[] = {	/* parser action names for debug */
 	[Apcdata]	"pcdata",	[Aattr]		"attr",
 	[Avalue]	"value",	[Aelem]		"elem",
 	[Aup]		"up",		[Adown]		"down",
-	[Acheck]	"check"
+	[Acheck]	"check",	[Aempty]	"empty"
 };
 
 
@@ -75,7 +76,7 @@ static int acttab[7][7] = {	/* Parser action table */
 /* 			Twhite	Topen	Tname	Tclose	Tequal	Tendblk	Tnulblk */         
 	[Slost]     {	Apcdata, Anop, 	Apcdata, Apcdata, Apcdata, Aup,	Apcdata },
 	[Sopened]   {	0, 	0, 	Aelem,	0, 	0, 	0, 	0 },
-	[Snamed]    {	Anop,	0, 	Aattr,	Adown,	0, 	Anop,	Anop },            
+	[Snamed]    {	Anop,	0, 	Aattr,	Adown,	0, 	Anop,	Aempty },          
 	[Sattred]   {	Anop, 	0, 	0, 	0, 	Anop,	0, 	0 },
 	[Sequed]    {	Anop, 	0, 	Avalue,	0, 	0, 	0, 	0 },
 	[Sendblk]   {	0, 	0, 	Acheck, 0, 	0, 	0, 	0 },
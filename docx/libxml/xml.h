@@ -5,25 +5,93 @@ typedef struct Xml Xml;
 typedef struct Attr Attr;
 typedef struct Elem Elem;
 
-typedef struct Xtree Xtree;
+typedef struct Xalloc Xalloc;
+typedef struct Xsax Xsax;
+typedef struct Xstats Xstats;
+typedef struct Xpath Xpath;
+typedef struct Xstep Xstep;
+
+typedef struct Xflat Xflat;
+typedef struct Xnode Xnode;
+typedef struct Xattr Xattr;
+typedef struct Xiter Xiter;
+
 typedef struct Xblock Xblock;
+typedef struct Xlazy Xlazy;
+typedef struct Xmatch Xmatch;
+typedef struct Xpush Xpush;
 
-#pragma incomplete Xtree
 #pragma incomplete Xblock
+#pragma incomplete Xlazy
+#pragma incomplete Xmatch
+#pragma incomplete Xpush
 
+/*
+ * Fparallel reads the whole document, cuts it between the
+ * children of its biggest element and parses the pieces in
+ * separate procs, each into its own arena; the tree, and
+ * any error, is the same as a serial parse gives. Files
+ * shorter than two pieces of 256K, and streams, are
+ * parsed serially, so it costs little to ask for it.
+ */
 enum {
 	Fcrushwhite = 1,
 	Fstripnamespace = 2,
+	Fparallel = 4,		/* xmlparse may use $NPROC procs */
+	Flazy = 8,		/* parse contents of the root's children when asked, see xmlchild */
+	Fintern = 16,		/* share short attribute values, see xmlintern */
+};
+
+/*
+ * What it took to build a tree, see xmlstats.
+ */
+struct Xstats {
+	vlong	requested;		/* bytes asked of the arena */
+	vlong	wasted;		/* lost to rounding and block tails */
+	int	allocs;		/* objects taken from the arena */
+	int	blocks;		/* arena blocks in use */
+	int	lookups;		/* names interned */
+	int	hits;			/* names already in the table */
+	double	hitrate;		/* hits/lookups */
+	int	elems;
+	int	attrs;
+	int	texts;			/* elements with pcdata */
+	int	maxdepth;		/* of elements, the root is 1 */
+	int	skipped;		/* elements whose contents weren't read, see xmlskip */
+	int	shared;		/* attribute values not copied, see Fintern */
+	vlong	parsens;		/* parse wall time in nanoseconds */
+};
+
+/*
+ * Where an arena's blocks come from, see xmlnewalloc and
+ * xmlsegalloc. Under Fparallel several procs may call
+ * these at once.
+ */
+struct Xalloc {
+	void	*aux;			/* for the allocator */
+	void*	(*alloc)(Xalloc *, ulong);	/* n bytes, or nil: the parse fails */
+	void	(*free)(Xalloc *, void *, ulong);	/* a block and its size */
 };
 
 struct Xml {
 	Elem	*root;			/* root of tree */
 	char	*doctype;		/* DOCTYPE structured comment, or nil */
 	struct {
-		Xtree	*root;
-		Xblock	*active;
-		int	blksiz;
+		Xblock	*active;		/* blocks in use, newest first */
+		Xblock	*large;		/* objects too big for a block */
+		Xblock	*spare;		/* blocks emptied by xmlreset */
+		int	blksiz;		/* size of the first block */
+		Xalloc	*a;		/* block source, nil for malloc */
 	} alloc;
+	int	*skip;			/* atoms given to xmlskip */
+	int	nskip;
+	int	*num;			/* atoms given to xmlnumeric */
+	int	nnum;
+	uchar	*src;			/* the document, kept for Flazy */
+	Xstats	stats;			/* see xmlstats */
+	int	nomem;			/* the Xalloc ran out, see newblock */
+	int	debug;			/* xmldebug when made */
+	char	err[ERRMAX];		/* why the last parse failed */
 };
 
 struct Elem {
@@ -34,6 +102,10 @@ struct Elem {
 	char	*name;			/* element name */
 	char	*pcdata;		/* pcdata following this element */
 	int	line;			/* Line number (for errors) */
+	int	atom;			/* name as an atom, see xmlatom */
+	int	local;			/* name less any prefix, as an atom */
+	int	ns;			/* namespace URI as an atom, or 0 */
+	Xlazy	*lazy;			/* child and pcdata not parsed yet, see xmlchild */
 };
 
 struct Attr {
@@ -41,21 +113,155 @@ struct Attr {
 	Elem	*parent;		/* parent element */
 	char	*name;			/* atributes name (nil for coments) */
 	char	*value;		/* atributes value */
+	int	atom;			/* name as an atom, see xmlatom */
+	int	local;			/* name less any prefix, as an atom */
+	int	ns;			/* namespace URI as an atom, or 0 */
+	int	decoded;		/* value decoded by the parser, see xmlnumeric */
+};
+
+/*
+ * A tree flattened by xmlflatten(): nodes and attributes
+ * in document order, linked by index, 0 is none and
+ * node[0] is the document. Names are atoms; text and
+ * values are offsets into text, -1 for nil.
+ */
+struct Xnode {
+	int	atom;			/* name, see xmlatom */
+	int	local;			/* name less any prefix */
+	int	ns;			/* namespace URI, or 0 */
+	int	child;			/* first child */
+	int	next;			/* next sibling */
+	int	parent;
+	int	attr;			/* first in attr[], they end at node[n+1]'s */
+	int	text;			/* pcdata, see xmlflattext */
+	int	ntext;			/* its length */
+	int	line;			/* Line number (for errors) */
+};
+
+struct Xattr {
+	int	atom;
+	int	local;
+	int	ns;
+	int	value;			/* offset into text */
+	int	nvalue;		/* its length */
+};
+
+struct Xflat {
+	Xnode	*node;			/* nnode and one to end the last's attributes */
+	int	nnode;
+	Xattr	*attr;
+	int	nattr;
+	char	*text;			/* NUL terminated strings */
+	long	ntext;
+};
+
+/*
+ * Walks a subtree of an Xflat, see xmliter().
+ */
+struct Xiter {
+	Xflat	*f;
+	int	top;			/* node whose subtree is walked */
+	int	node;			/* last returned */
+	int	depth;			/* of node below top */
+	int	skip;			/* don't go below node */
+};
+
+/*
+ * Event callbacks for xmlsax(), any may be nil.
+ * text delivers the pcdata of the innermost open element
+ * just before its end, so after the events of all its
+ * children, as one string: text between and around the
+ * children is joined, as in Elem.pcdata, and its place
+ * among them is not kept. Names are interned, see xmlatom,
+ * and stay valid; attribute values and pcdata only for
+ * the duration of the call.
+ */
+struct Xsax {
+	void	*aux;			/* for the caller */
+	void	(*start)(Xsax *, char *, int, int);	/* element name, its atom, line */
+	void	(*attr)(Xsax *, char *, int, char *);	/* attribute name, its atom, value */
+	void	(*text)(Xsax *, char *);		/* pcdata */
+	void	(*end)(Xsax *, char *);		/* element name */
+};
+
+/*
+ * A path compiled by xmlpath(), run with xmlquery() and xmlnext().
+ */
+struct Xstep {
+	int	atom;			/* element name */
+	int	attr;			/* attribute it must have, or 0 */
+	char	*value;		/* value attr must have, or nil */
+};
+
+struct Xpath {
+	int	nstep;
+	Xstep	*step;
 };
 
-extern int xmldebug;
+extern int xmldebug;		/* debug level for new Xmls */
 
+int	xmlatom(char *);
+char*	xmlatomname(int);
+void	xmlatomreset(void);
+int	xmlatomcell(Elem *, int, int *, int *);
+double	xmlatomnum(Elem *, int, double);
+char*	xmlatomvalue(Elem *, int);
 Attr*	xmlattr(Xml *, Attr **, Elem *, char *, char *);
+int	xmlcell(Elem *, char *, int *, int *);
+Elem*	xmlchild(Elem *);
 Elem*	xmlelem(Xml *, Elem **, Elem *, char *);
 Elem*	xmlfind(Xml *, Elem *, char *);
+Xflat*	xmlflatten(Xml *);
+void	xmlflatfree(Xflat *);
+char*	xmlflattext(Xflat *, int);
+char*	xmlflatvalue(Xflat *, int, char *);
 void	xmlfree(Xml *);
 char*	xmlstrdup(Xml*, char *, int);
 void*	xmlcalloc(Xml *, int, int);
 void*	xmlmalloc(Xml *, int);
-void	_Xheapstats(void);
+void	_Xheapstats(Xml *);
 void	_Xheapfree(Xml *);
+char*	_Xintern(Xml *, char *, int *);
+char*	_Xinternq(Xml *, char *, int *, int *, int *, char **);
+char*	_Xinternval(Xml *, char *);
+int	_Xatomn(char *, int);
+uchar*	_Xscan(uchar *, uchar *, int, int);
+uchar*	_Xscanesc(uchar *, uchar *);
+uchar*	_Xutf(uchar *, uchar *);
+int	_Xsplit(uchar *, uchar *, uchar **, int, uchar **);
+void	_Xheapjoin(Xml *, Xml *);
+int	_Xnumvalue(Xml *, int *, int, Attr *, char *);
+char*	xmlintern(char *);
+void	xmliter(Xiter *, Xflat *, int);
+int	xmliternext(Xiter *);
+void	xmliterskip(Xiter *);
 Elem*	xmllook(Elem *, char *, char *, char *);
+void	xmlmatch(Xmatch *, Elem *, void *);
+int	xmlmatchadd(Xmatch *, char *, void (*)(Elem *, void *, void *), void *);
+int	xmlmatchfd(Xmatch *, int, int, void *);
+void	xmlmatchfree(Xmatch *);
+Xmatch*	xmlmatchnew(void);
 Xml*	xmlnew(int);
+Xml*	xmlnewalloc(int, Xalloc *);
+double	xmlnum(Elem *, char *, double);
+void	xmlnumeric(Xml *, char *);
+Elem*	xmlnext(Xpath *, Elem *);
 Xml*	xmlparse(int, int, int);
+Xpath*	xmlpath(char *);
+void	xmlpathfree(Xpath *);
 void	xmlprint(Xml *, int);
+void	xmlprintc(Xml *, int);
+int	xmlpush(Xpush *, void *, long);
+Xml*	xmlpushdone(Xpush *);
+Xpush*	xmlpushnew(int, int);
+Elem*	xmlquery(Xpath *, Elem *);
+int	xmlreparse(Xml *, int, int);
+void	xmlreset(Xml *);
+void	xmlskip(Xml *, char *);
+int	xmlsax(int, Xsax *, int);
+Xalloc*	xmlsegalloc(char *, ulong);
+void	xmlsegfree(Xalloc *);
+Xml*	xmlsnapload(int, int);
+int	xmlsnapshot(Xml *, int);
+void	xmlstats(Xml *, Xstats *);
 char*	xmlvalue(Elem *, char *);
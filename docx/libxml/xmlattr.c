@@ -2,12 +2,16 @@
 #include <libc.h>
 #include "xml.h"
 
+/*
+ * append a new attribute to the list at *root. Callers building
+ * long lists can pass the address of the last node's next
+ * field as root so the list need not be walked.
+ */
 Attr *
 xmlattr(Xml *xp, Attr **root, Elem *parent, char *name, char *value)
 {
 	Attr *ap, *t;
 
-	USED(xp);
 	if((ap = xmlcalloc(xp, sizeof(Attr), 1)) == nil)
 		sysfatal("no memory - %r\n");
 	if(*root == nil){
@@ -19,9 +23,10 @@ xmlattr(Xml *xp, Attr **root, Elem *parent, char *name, char *value)
 		t->next = ap;
 	}
 	ap->parent = parent;
+	xp->stats.attrs++;
 
 	if(name)
-		if((ap->name = xmlstrdup(xp, name, 1)) == nil)
+		if((ap->name = _Xinternq(xp, name, &ap->atom, nil, &ap->local, nil)) == nil)
 			sysfatal("no memory - %r\n");
 
 	if(value)
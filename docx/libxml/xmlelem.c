@@ -2,12 +2,16 @@
 #include <libc.h>
 #include "xml.h"
 
+/*
+ * append a new element to the list at *root. Callers building
+ * long lists can pass the address of the last node's next
+ * field as root so the list need not be walked.
+ */
 Elem *
 xmlelem(Xml *xp, Elem **root, Elem *parent, char *name)
 {
 	Elem *ep, *t;
 
-	USED(xp);
 	if((ep = xmlcalloc(xp, sizeof(Elem), 1)) == nil)
 		sysfatal("no memory - %r\n");
 	if(! *root){
@@ -19,8 +23,9 @@ xmlelem(Xml *xp, Elem **root, Elem *parent, char *name)
 		t->next = ep;
 	}
 	ep->parent = parent;
+	xp->stats.elems++;
 	if(name)
-		if((ep->name = xmlstrdup(xp, name, 1)) == nil)
+		if((ep->name = _Xinternq(xp, name, &ep->atom, nil, &ep->local, nil)) == nil)
 			sysfatal("no memory - %r\n");
 	return ep;
 }
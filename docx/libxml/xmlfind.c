@@ -4,12 +4,15 @@
 
 /*
  * search for element, starting at ep.
+ * each name in path must match an element's whole
+ * name; "w:p" no longer finds "w:pPr".
  */
 
 Elem *
 xmlfind(Xml *xp, Elem *ep, char *path)
 {
 	char *p;
+	int atom;
 	Elem *t;
 
 	USED(xp);
@@ -22,11 +25,12 @@ xmlfind(Xml *xp, Elem *ep, char *path)
 		if((p = strchr(path, 0)) == nil)
 			return nil;		// shut up lint !
 
+	atom = _Xatomn(path, p-path);
 	for(; ep; ep = ep->next)
-		if (strncmp(ep->name, path, p-path) == 0){
+		if (ep->atom == atom){
 			if (*p == 0)
 				return ep;
-			if (! ep->child)
+			if (! xmlchild(ep))
 				continue;
 			if ((t = xmlfind(xp, ep->child, p)) != nil)
 				return t;
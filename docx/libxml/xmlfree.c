@@ -6,5 +6,8 @@ void
 xmlfree(Xml *xp)
 {
 	_Xheapfree(xp);
+	free(xp->skip);
+	free(xp->num);
+	free(xp->src);
 	free(xp);
 }
@@ -7,12 +7,14 @@
  * search for element, starting at ep.
  * if attr!=nil the elem must have an attribute attr
  * if value!=nil then the elem must have attr=value
+ * names in path match whole element names, as attr does
  */
 
 Elem *
 xmllook(Elem *ep, char *path, char *attr, char *value)
 {
 	char *p;
+	int atom, aatom;
 	Elem *t;
 	Attr *ap;
 
@@ -24,10 +26,14 @@ xmllook(Elem *ep, char *path, char *attr, char *value)
 		if((p = strchr(path, 0)) == nil)
 			return nil;			// shut up lint !
 
+	atom = _Xatomn(path, p-path);
+	aatom = 0;
+	if (attr != nil)
+		aatom = _Xatomn(attr, strlen(attr));
 	for(; ep; ep = ep->next)
-		if (strncmp(ep->name, path, p-path) == 0){
+		if (ep->atom == atom){
 			if (*p == '/'){
-				if (ep->child)
+				if (xmlchild(ep))
 					if ((t = xmllook(ep->child, p, attr, value)) != nil)
 						return t;
 				continue;
@@ -35,13 +41,13 @@ xmllook(Elem *ep, char *path, char *attr, char *value)
 			if (attr == nil)
 				return ep;
 			for (ap = ep->attrs; ap; ap = ap->next)
-				if (strcmp(ap->name, attr) == 0){
+				if (ap->atom == aatom){
 					if (value == nil)
 						return ep;
 					if (strcmp(ap->value, value) == 0)
 						return ep;
 				}
-			if (ep->child)
+			if (xmlchild(ep))
 				if ((t = xmllook(ep->child, p, attr, value)) != nil)
 					return t;
 		}
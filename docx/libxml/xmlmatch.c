@@ -0,0 +1,469 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Match many paths in one pass. Patterns are kept in two
+ * tries of atoms, one for those anchored at the top of the
+ * walk ("/a/b") and one for those that may start at any
+ * depth ("a/b"). The set of trie nodes live at each level
+ * is a state of a DFA which is built lazily as new
+ * (state, element name) pairs are seen, so after the first
+ * few elements each node costs one hash probe.
+ */
+
+enum {
+	Nhash = 16,
+};
+
+typedef struct Node Node;
+typedef struct Rule Rule;
+typedef struct Dstate Dstate;
+typedef struct Trans Trans;
+typedef struct Frame Frame;
+
+struct Rule {
+	Rule	*next;			/* next rule for this node */
+	int	id;			/* order of registration */
+	void	(*fn)(Elem *, void *, void *);
+	void	*aux;
+};
+
+struct Node {
+	Node	*kid;
+	Node	*sib;
+	int	atom;
+	Rule	*rules;
+};
+
+struct Trans {
+	Trans	*next;
+	int	atom;
+	Dstate	*to;
+};
+
+struct Dstate {
+	Dstate	*next;
+	int	n;
+	Node	**set;
+	int	nfire;
+	Rule	**fire;		/* handlers to call, in registration order */
+	Trans	*hash[Nhash];
+};
+
+/* an open element when matching an event stream */
+struct Frame {
+	Elem	elem;
+	Attr	*atail;
+	Dstate	*ds;
+};
+
+struct Xmatch {
+	Node	abs;			/* root of anchored patterns */
+	Node	any;			/* root of floating patterns */
+	int	nrule;
+	Dstate	*states;
+	Dstate	*start;
+
+	Xsax	sax;
+	Frame	**stack;
+	int	depth;
+	int	maxdepth;
+	Frame	*pending;		/* start tag not yet complete */
+	void	*arg;			/* given to xmlmatchfd */
+};
+
+static void
+freestates(Xmatch *m)
+{
+	Dstate *ds, *nds;
+	Trans *t, *nt;
+	int i;
+
+	for(ds = m->states; ds; ds = nds){
+		nds = ds->next;
+		for(i = 0; i < Nhash; i++)
+			for(t = ds->hash[i]; t; t = nt){
+				nt = t->next;
+				free(t);
+			}
+		free(ds->set);
+		free(ds->fire);
+		free(ds);
+	}
+	m->states = nil;
+	m->start = nil;
+}
+
+static void
+freenodes(Node *np)
+{
+	Node *nnp;
+	Rule *rp, *nrp;
+
+	for(; np; np = nnp){
+		nnp = np->sib;
+		freenodes(np->kid);
+		for(rp = np->rules; rp; rp = nrp){
+			nrp = rp->next;
+			free(rp);
+		}
+		free(np);
+	}
+}
+
+Xmatch *
+xmlmatchnew(void)
+{
+	return mallocz(sizeof(Xmatch), 1);
+}
+
+void
+xmlmatchfree(Xmatch *m)
+{
+	int i;
+
+	if(m == nil)
+		return;
+	freestates(m);
+	freenodes(m->abs.kid);
+	freenodes(m->any.kid);
+	for(i = 0; i < m->maxdepth; i++)
+		free(m->stack[i]);
+	free(m->stack);
+	free(m);
+}
+
+/*
+ * add a pattern, fn(ep, aux, arg) will be called for
+ * every element that matches it, arg being what was given
+ * to xmlmatch or xmlmatchfd for that walk. Patterns starting with '/'
+ * are anchored at the elements the walk starts from,
+ * others match at any depth.
+ */
+int
+xmlmatchadd(Xmatch *m, char *pattern, void (*fn)(Elem *, void *, void *), void *aux)
+{
+	char *p, *e, buf[256];
+	Node *np, *kp;
+	Rule *rp, **rpp;
+	int atom;
+
+	if(*pattern == '/'){
+		np = &m->abs;
+		p = pattern+1;
+	}else{
+		np = &m->any;
+		p = pattern;
+	}
+	if(*p == 0){
+		werrstr("%s: empty pattern", pattern);
+		return -1;
+	}
+	for(; *p; p = e){
+		if((e = strchr(p, '/')) == nil)
+			e = strchr(p, 0);
+		if(e == p || e-p >= sizeof(buf)){
+			werrstr("%s: bad name", pattern);
+			return -1;
+		}
+		memmove(buf, p, e-p);
+		buf[e-p] = 0;
+		if(*e == '/' && *++e == 0){
+			werrstr("%s: trailing '/'", pattern);
+			return -1;
+		}
+
+		atom = xmlatom(buf);
+		for(kp = np->kid; kp; kp = kp->sib)
+			if(kp->atom == atom)
+				break;
+		if(kp == nil){
+			if((kp = mallocz(sizeof(Node), 1)) == nil)
+				return -1;
+			kp->atom = atom;
+			kp->sib = np->kid;
+			np->kid = kp;
+		}
+		np = kp;
+	}
+
+	if((rp = mallocz(sizeof(Rule), 1)) == nil)
+		return -1;
+	rp->id = m->nrule++;
+	rp->fn = fn;
+	rp->aux = aux;
+	for(rpp = &np->rules; *rpp; rpp = &(*rpp)->next)
+		;
+	*rpp = rp;
+
+	/* cached states no longer describe the tries */
+	freestates(m);
+	return 0;
+}
+
+static int
+nodecmp(void *a, void *b)
+{
+	Node *x, *y;
+
+	x = *(Node **)a;
+	y = *(Node **)b;
+	if(x < y)
+		return -1;
+	return x > y;
+}
+
+static int
+rulecmp(void *a, void *b)
+{
+	return (*(Rule **)a)->id - (*(Rule **)b)->id;
+}
+
+/*
+ * find or make the state for a set of nodes,
+ * the set is consumed.
+ */
+static Dstate *
+dstate(Xmatch *m, Node **set, int n)
+{
+	Dstate *ds;
+	Rule *rp;
+	int i, nfire;
+
+	qsort(set, n, sizeof(Node *), nodecmp);
+	for(ds = m->states; ds; ds = ds->next)
+		if(ds->n == n && memcmp(ds->set, set, n*sizeof(Node *)) == 0){
+			free(set);
+			return ds;
+		}
+
+	if((ds = mallocz(sizeof(Dstate), 1)) == nil)
+		sysfatal("xmlmatch: no memory for state\n");
+	ds->n = n;
+	ds->set = set;
+	nfire = 0;
+	for(i = 0; i < n; i++)
+		for(rp = set[i]->rules; rp; rp = rp->next)
+			nfire++;
+	if(nfire){
+		if((ds->fire = malloc(nfire * sizeof(Rule *))) == nil)
+			sysfatal("xmlmatch: no memory for state\n");
+		for(i = 0; i < n; i++)
+			for(rp = set[i]->rules; rp; rp = rp->next)
+				ds->fire[ds->nfire++] = rp;
+		qsort(ds->fire, nfire, sizeof(Rule *), rulecmp);
+	}
+	ds->next = m->states;
+	m->states = ds;
+	return ds;
+}
+
+static Dstate *
+start(Xmatch *m)
+{
+	Node **set;
+
+	if(m->start == nil){
+		if((set = malloc(2 * sizeof(Node *))) == nil)
+			sysfatal("xmlmatch: no memory for state\n");
+		set[0] = &m->abs;
+		set[1] = &m->any;
+		m->start = dstate(m, set, 2);
+	}
+	return m->start;
+}
+
+static Dstate *
+step(Xmatch *m, Dstate *ds, int atom)
+{
+	Trans *t, **tp;
+	Node **set, *kp;
+	int i, n, max;
+
+	tp = &ds->hash[atom & (Nhash-1)];
+	for(t = *tp; t; t = t->next)
+		if(t->atom == atom)
+			return t->to;
+
+	max = 1;
+	for(i = 0; i < ds->n; i++)
+		for(kp = ds->set[i]->kid; kp; kp = kp->sib)
+			if(kp->atom == atom)
+				max++;
+	if((set = malloc(max * sizeof(Node *))) == nil)
+		sysfatal("xmlmatch: no memory for state\n");
+	n = 0;
+	set[n++] = &m->any;
+	for(i = 0; i < ds->n; i++)
+		for(kp = ds->set[i]->kid; kp; kp = kp->sib)
+			if(kp->atom == atom)
+				set[n++] = kp;
+
+	if((t = malloc(sizeof(Trans))) == nil)
+		sysfatal("xmlmatch: no memory for state\n");
+	t->atom = atom;
+	t->to = dstate(m, set, n);
+	t->next = *tp;
+	*tp = t;
+	return t->to;
+}
+
+static void
+fire(Dstate *ds, Elem *ep, void *arg)
+{
+	Rule *rp;
+	int i;
+
+	for(i = 0; i < ds->nfire; i++){
+		rp = ds->fire[i];
+		rp->fn(ep, rp->aux, arg);
+	}
+}
+
+static void
+walk(Xmatch *m, Dstate *ds, Elem *ep, void *arg)
+{
+	Dstate *nds;
+
+	for(; ep; ep = ep->next){
+		nds = step(m, ds, ep->atom);
+		fire(nds, ep, arg);
+		if(xmlchild(ep))
+			walk(m, nds, ep->child, arg);
+	}
+}
+
+/*
+ * walk ep, its siblings and all their descendants in
+ * document order calling the handler for each match
+ * with arg. The walk keeps its place on the stack, so a
+ * handler may start another with the same m, but the
+ * states are built as it goes: procs need an m each.
+ */
+void
+xmlmatch(Xmatch *m, Elem *ep, void *arg)
+{
+	walk(m, start(m), ep, arg);
+}
+
+/*
+ * Event stream. Handlers run once an element's start tag
+ * is complete, so its attributes and parent chain are there
+ * but its pcdata and children are not. Attributes are only
+ * kept for elements that match, so an ancestor's are nil
+ * unless it matched too.
+ */
+static void
+flush(Xmatch *m)
+{
+	Frame *f;
+
+	if((f = m->pending) == nil)
+		return;
+	m->pending = nil;
+	fire(f->ds, &f->elem, m->arg);
+}
+
+static void
+evstart(Xsax *sax, char *name, int atom, int line)
+{
+	Xmatch *m;
+	Frame *f, *parent;
+
+	m = sax->aux;
+	flush(m);
+	if(m->depth == m->maxdepth){
+		m->maxdepth += 16;
+		if((m->stack = realloc(m->stack, m->maxdepth * sizeof(Frame *))) == nil)
+			sysfatal("xmlmatch: no memory for stack\n");
+		memset(&m->stack[m->depth], 0, 16 * sizeof(Frame *));
+	}
+	if((f = m->stack[m->depth]) == nil)
+		if((f = m->stack[m->depth] = malloc(sizeof(Frame))) == nil)
+			sysfatal("xmlmatch: no memory for stack\n");
+	parent = m->depth? m->stack[m->depth-1]: nil;
+	m->depth++;
+
+	memset(&f->elem, 0, sizeof(Elem));
+	f->elem.name = name;
+	f->elem.atom = atom;
+	f->elem.line = line;
+	f->elem.parent = parent? &parent->elem: nil;
+	f->atail = nil;
+	f->ds = step(m, parent? parent->ds: start(m), f->elem.atom);
+	if(f->ds->nfire)
+		m->pending = f;
+}
+
+static void
+evattr(Xsax *sax, char *name, int atom, char *value)
+{
+	Xmatch *m;
+	Frame *f;
+	Attr *ap;
+
+	m = sax->aux;
+	if((f = m->pending) == nil)
+		return;
+	if((ap = mallocz(sizeof(Attr), 1)) == nil)
+		sysfatal("xmlmatch: no memory for attribute\n");
+	ap->parent = &f->elem;
+	ap->name = name;
+	ap->atom = atom;
+	if((ap->value = strdup(value)) == nil)
+		sysfatal("xmlmatch: no memory for attribute\n");
+	if(f->atail)
+		f->atail->next = ap;
+	else
+		f->elem.attrs = ap;
+	f->atail = ap;
+}
+
+static void
+evtext(Xsax *sax, char *)
+{
+	flush(sax->aux);
+}
+
+static void
+evend(Xsax *sax, char *)
+{
+	Xmatch *m;
+	Frame *f;
+	Attr *ap, *nap;
+
+	m = sax->aux;
+	flush(m);
+	if(m->depth == 0)
+		return;
+	f = m->stack[--m->depth];
+	for(ap = f->elem.attrs; ap; ap = nap){
+		nap = ap->next;
+		free(ap->value);
+		free(ap);
+	}
+}
+
+/*
+ * as xmlmatch but for the document read from fd,
+ * without building a tree.
+ */
+int
+xmlmatchfd(Xmatch *m, int fd, int flags, void *arg)
+{
+	int rc;
+
+	m->arg = arg;
+	m->sax.aux = m;
+	m->sax.start = evstart;
+	m->sax.attr = evattr;
+	m->sax.text = evtext;
+	m->sax.end = evend;
+	m->depth = 0;
+	m->pending = nil;
+	rc = xmlsax(fd, &m->sax, flags);
+	while(m->depth > 0)
+		evend(&m->sax, nil);
+	return rc;
+}
@@ -4,12 +4,24 @@
 
 Xml *
 xmlnew(int blksize)
+{
+	return xmlnewalloc(blksize, nil);
+}
+
+/*
+ * an Xml whose arena takes its blocks from a rather than
+ * malloc, nil means malloc. a must outlive the Xml.
+ */
+Xml *
+xmlnewalloc(int blksize, Xalloc *a)
 {
 	Xml *xp;
 
 	xp = mallocz(sizeof(Xml), 1);
-	xp->alloc.blksiz = blksize;
 	if(xp == nil)
 		return nil;
+	xp->alloc.blksiz = blksize;
+	xp->alloc.a = a;
+	xp->debug = xmldebug;
 	return xp;
 }
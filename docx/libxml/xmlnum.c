@@ -0,0 +1,190 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Attribute values as numbers. A value is a number if it
+ * starts like one, as atof would take it, and a cell
+ * reference if it is one to three letters then a row, as
+ * in "AB12". Attributes named with xmlnumeric are decoded
+ * by the parser as it copies their values: the result
+ * goes in the arena just ahead of the string and the
+ * Attr's decoded says what it is, so reading one again is
+ * a test and a load. Others are decoded each time they are
+ * asked for. Nothing writes the tree after the parse, so
+ * procs may read it at once.
+ */
+
+enum {
+	Dnone = 1,		/* decoded, neither; 0 is not decoded */
+	Dnum,
+	Dcell,
+};
+
+typedef struct Num Num;
+struct Num {
+	union {
+		double	num;
+		struct {
+			int	col;
+			int	row;
+		} cell;
+	};
+};
+
+static int
+cell(Num *np, char *s)
+{
+	int col, row, n;
+	char *p;
+
+	col = 0;
+	for(p = s, n = 0; n < 3; p++, n++)
+		if(*p >= 'A' && *p <= 'Z')
+			col = col*26 + *p-'A'+1;
+		else if(*p >= 'a' && *p <= 'z')
+			col = col*26 + *p-'a'+1;
+		else
+			break;
+	if(n == 0 || *p < '1' || *p > '9')
+		return Dnone;
+	for(row = 0; *p >= '0' && *p <= '9'; p++)
+		row = row*10 + *p-'0';
+	if(*p != 0)
+		return Dnone;
+	np->cell.col = col;
+	np->cell.row = row;
+	return Dcell;
+}
+
+static int
+decode(Num *np, char *p)
+{
+	char *e;
+	double d;
+
+	if(p == nil)
+		return Dnone;
+	while(*p == ' ' || *p == '\t')
+		p++;
+	if(*p == '-' || *p == '+' || *p == '.' || *p >= '0' && *p <= '9'){
+		d = strtod(p, &e);
+		if(e == p)
+			return Dnone;
+		np->num = d;
+		return Dnum;
+	}
+	return cell(np, p);
+}
+
+/*
+ * have xmlreparse decode attributes called name as it
+ * reads them, for xmlnum and xmlcell
+ */
+void
+xmlnumeric(Xml *xp, char *name)
+{
+	int i, atom;
+
+	atom = xmlatom(name);
+	for(i = 0; i < xp->nnum; i++)
+		if(xp->num[i] == atom)
+			return;
+	if((xp->num = realloc(xp->num, (xp->nnum+1) * sizeof(int))) == nil)
+		sysfatal("xmlnumeric: no memory\n");
+	xp->num[xp->nnum++] = atom;
+}
+
+/*
+ * give ap the value val, decoded, if it is one of those
+ * named by num; -1 if it isn't.
+ */
+int
+_Xnumvalue(Xml *xp, int *num, int nnum, Attr *ap, char *val)
+{
+	int i, n;
+	Num *np;
+
+	for(i = 0; i < nnum; i++)
+		if(num[i] == ap->atom)
+			break;
+	if(i == nnum)
+		return -1;
+	n = strlen(val);
+	np = xmlmalloc(xp, sizeof(Num) + n+1);
+	ap->decoded = decode(np, val);
+	ap->value = (char *)&np[1];
+	memmove(ap->value, val, n+1);
+	return 0;
+}
+
+/*
+ * ep's attribute atom decoded into *np: what it is, or -1
+ * if ep has no such attribute.
+ */
+static int
+look(Elem *ep, int atom, Num *np)
+{
+	Attr *ap;
+
+	if(ep == nil)
+		return -1;
+	for(ap = ep->attrs; ap; ap = ap->next)
+		if(ap->atom == atom){
+			if(ap->decoded){
+				*np = ((Num *)ap->value)[-1];
+				return ap->decoded;
+			}
+			return decode(np, ap->value);
+		}
+	return -1;
+}
+
+/*
+ * the value of ep's attribute atom as a number, or def if
+ * there is none or it isn't one.
+ */
+double
+xmlatomnum(Elem *ep, int atom, double def)
+{
+	Num n;
+
+	if(look(ep, atom, &n) != Dnum)
+		return def;
+	return n.num;
+}
+
+double
+xmlnum(Elem *ep, char *name, double def)
+{
+	if(ep == nil)
+		return def;
+	return xmlatomnum(ep, _Xatomn(name, strlen(name)), def);
+}
+
+/*
+ * ep's attribute atom as a cell reference: sets *col, with
+ * A as 1, and *row, either may be nil. -1 if there is no
+ * such attribute or it isn't a cell.
+ */
+int
+xmlatomcell(Elem *ep, int atom, int *col, int *row)
+{
+	Num n;
+
+	if(look(ep, atom, &n) != Dcell)
+		return -1;
+	if(col)
+		*col = n.cell.col;
+	if(row)
+		*row = n.cell.row;
+	return 0;
+}
+
+int
+xmlcell(Elem *ep, char *name, int *col, int *row)
+{
+	if(ep == nil)
+		return -1;
+	return xmlatomcell(ep, _Xatomn(name, strlen(name)), col, row);
+}
@@ -1,7 +1,6 @@
 #include <u.h>
 #include <libc.h>
 #include <ctype.h>
-#include <bio.h>
 #include "xml.h"
 #include "state-machine.h"
 
@@ -17,23 +16,127 @@ enum {
 
 enum {
 	Ntext = 1024,	/* longest name or atribute value possible */
-	Nref = 32	/* longest entity reference name */
+	Nref = 32,	/* longest entity reference name */
+	Nwin = 64*1024,	/* input window size */
+	Npart = 32,	/* most pieces a parallel parse is split into */
+	Minpart = 256*1024,	/* least input per piece */
+	Nvalid = 64*1024,	/* most UTF-8 checked at a time */
 };
 
+/* bytes in the sequence led by c, which _Xutf found sound */
+#define Utflen(c)	((c) < 0xe0? 2: (c) < 0xf0? 3: 4)
+
+typedef struct Bind Bind;
+typedef struct Frag Frag;
+typedef struct Part Part;
+
+/* pcdata found between the top level elements of a part */
+struct Frag {
+	Frag *next;
+	char str[1];	/* allocated to fit */
+};
+
+/*
+ * a piece of a document parsed by another proc, the main
+ * parse jumps over it and splices in the result.
+ */
+struct Part {
+	uchar *start;	/* first byte */
+	uchar *end;	/* byte after the last */
+	int line;	/* line number at start */
+	int endline;	/* and at end */
+	Xml *xml;	/* holds the part's nodes */
+	Elem *root;	/* first top level element */
+	Frag *frags;	/* text between top level elements */
+	uchar **anc;	/* start tags of the parts' ancestors */
+	Bind *ctx;	/* prefixes in scope where the parts are */
+	int nctx;
+	int *skip;	/* see xmlskip */
+	int nskip;
+	int *num;	/* see xmlnumeric */
+	int nnum;
+	int ok;		/* parsed cleanly */
+};
+
+/*
+ * a namespace prefix in scope, declared by an element at
+ * depth or, if -1, outside what is being parsed.
+ */
+struct Bind {
+	int prefix;	/* atom, 0 for the default namespace */
+	int ns;		/* URI as an atom, 0 to undeclare */
+	int depth;
+};
 
 typedef struct {
 	int line;	/* Line number (for errors) */
-	Biobuf *bp;	/* input stream */
+	int fd;		/* input stream */
+	uchar *buf;	/* input window */
+	uchar *rp;	/* read cursor */
+	uchar *ep;	/* end of data in the window */
+	uchar *lp;	/* newlines before here are counted in line */
+	uchar *vp;	/* UTF-8 from rp to here is known good */
+	int eof;	/* no more data to read from fd */
 	int flags;	/* misc flags, see xml.h */
 	Xml *xml;
+	Xsax *sax;	/* deliver events rather than build a tree */
 	int failed;
+	int debug;	/* copied from xml */
+	Part *part;	/* next part to splice in */
+	Part *epart;	/* end of the parts */
+	Elem *top;	/* stands in for the parent of a part */
+	Frag **ftail;	/* where the next frag goes */
+	Bind *bind;	/* namespace prefixes in scope, innermost last */
+	int nbind;
+	int maxbind;
+	int axml;	/* atoms of xml and xmlns, and the URI xml: is bound to */
+	int axmlns;
+	int nsxml;
+	int *skip;	/* elements whose contents are passed over */
+	int nskip;
+	int *num;	/* attributes decoded as they are read */
+	int nnum;
+	int base;	/* depth of the parent of what is parsed */
 } State;
 
+/*
+ * the unparsed contents of an element, see Flazy
+ */
+struct Xlazy {
+	Xml *xml;
+	uchar *start;	/* just after the start tag */
+	uchar *end;	/* the end tag */
+	int line;	/* at start */
+	int base;	/* depth of the element */
+	int flags;
+	int nbind;
+	Bind bind[1];	/* prefixes in scope, allocated to fit */
+};
+
 typedef struct {
 	char *buf;
 	int sz;
+	int n;		/* bytes in use, buf[n] is NUL */
 } Lexbuf;
 
+/*
+ * an element whose contents are being parsed; the parse
+ * keeps a stack of these rather than recursing, so deep
+ * documents cost heap, not stack. Frames are kept for
+ * reuse until the parse ends.
+ */
+typedef struct Frame Frame;
+struct Frame {
+	Frame *up;
+	Frame *down;
+	Elem *parent;	/* whose contents these are */
+	Elem *root;	/* first element at this level */
+	Elem *ep;	/* and the last */
+	int s;		/* parser state */
+	int pc;		/* where parent's pcdata starts in the shared buffer */
+	Elem selem;	/* ep in event mode */
+};
+
 
 static int 
 trimwhite(char *s)
@@ -50,50 +153,112 @@ trimwhite(char *s)
 	return 1;
 }
 
+/*
+ * room for n more bytes and a NUL
+ */
 static void
-growstr(State *st, Lexbuf *lb, char *str)
+grow(Lexbuf *lb, int n)
 {
-	int b, s, sz;
+	int sz;
 
-	if(str == nil || *str == 0)
+	if(lb->n+n+1 <= lb->sz)
 		return;
-	if((st->flags & Fcrushwhite) && trimwhite(str) &&
-	   (lb->buf == nil || lb->buf[0] == 0))
+	sz = lb->sz*2;
+	if(sz < lb->n+n+1)
+		sz = lb->n+n+1;
+	sz = Roundup(sz, Grain);
+	lb->buf = realloc(lb->buf, sz);
+	if(lb->buf == nil)
+		sysfatal("No memory, wanted %d bytes\n", sz);
+	lb->sz = sz;
+}
+
+/*
+ * append str, n bytes long, to the pcdata in pc that
+ * starts at start. Under Fcrushwhite text that is all
+ * whitespace becomes a space, or nothing if it comes first.
+ */
+static void
+growstr(State *st, Lexbuf *pc, int start, char *str, int n)
+{
+	if(n == 0)
 		return;
-	b = 0;
-	if(lb->buf)
-		b = strlen(lb->buf);
-	s = strlen(str);
+	if((st->flags & Fcrushwhite) && trimwhite(str)){
+		if(pc->n == start)
+			return;
+		n = 1;
+	}
+	grow(pc, n);
+	memmove(pc->buf+pc->n, str, n);
+	pc->n += n;
+	pc->buf[pc->n] = 0;
+}
 
-	sz = Roundup(b+s+1, Grain);
-	if(sz >= lb->sz){
-		lb->buf = realloc(lb->buf, sz);
-		if(lb->buf == nil)
-			sysfatal("No memory, wanted %d bytes\n", sz);
-		lb->sz = sz;
+/*
+ * append n bytes of raw input to the lexer's buffer.
+ * Fcrushwhite drops leading whitespace and turns the
+ * rest into spaces, exactly as growstr would if it were
+ * fed the same text one rune at a time.
+ */
+static void
+growspan(State *st, Lexbuf *lb, char *s, int n)
+{
+	char *p, *e;
+
+	if(n <= 0)
+		return;
+	grow(lb, n);
+	p = lb->buf + lb->n;
+	if(st->flags & Fcrushwhite){
+		for(e = s+n; s < e; s++)
+			if(! isspace(*s))
+				*p++ = *s;
+			else if(p != lb->buf)
+				*p++ = ' ';
 	}
-	strcpy(lb->buf+b, str);
+	else{
+		memmove(p, s, n);
+		p += n;
+	}
+	*p = 0;
+	lb->n = p - lb->buf;
 }
 
 static void
 growrune(State *st, Lexbuf *lb, Rune r)
 {
 	int n;
-	char str[UTFmax+1];
+	char str[UTFmax];
 
+	if(r == 0)
+		return;
 	n = runetochar(str, &r);
-	str[n] = 0;
-	growstr(st, lb, str);
+	growspan(st, lb, str, n);
 }
 
-static void
-stripns(char *str)
+static char *
+localname(char *str)
 {
 	char *p;
 	
 	if((p = strrchr(str, ':')) == nil)
-		return;
-	strcpy(str, p+1);
+		return str;
+	return p+1;
+}
+
+/*
+ * line numbers are counted lazily, in bulk, whenever
+ * someone asks for them or the window is about to slide.
+ */
+static int
+line(State *st)
+{
+	uchar *p;
+
+	for(p = st->lp; (p = memchr(p, '\n', st->rp - p)) != nil; p++)
+		st->line++;
+	st->lp = st->rp;
+	return st->line;
 }
 
 static void
@@ -101,45 +266,105 @@ failed(State *st, char *fmt, ...)
 {
 	int n;
 	va_list arg;
-	char err[ERRMAX];
+	char *err;
 
+	/* kept in the Xml, errstr is only set when the parse returns */
 	st->failed = 1;
+	err = st->xml->err;
 	va_start(arg, fmt);
-	n = snprint(err, sizeof(err), "%d ", st->line);
-	vsnprint(err+n, sizeof(err)-n, fmt, arg);
+	n = snprint(err, ERRMAX, "%d ", line(st));
+	vsnprint(err+n, ERRMAX-n, fmt, arg);
 	va_end(arg);
-	werrstr("%s", err);
-	
 }
 
-static void
-unget(State *st, int c)
+/*
+ * make at least n bytes available at the read cursor,
+ * sliding the window down and reading more as needed.
+ * returns the number of bytes available, which is only
+ * less than n at EOF.
+ */
+static long
+fill(State *st, long n)
 {
-	if(c == '\n')
-		st->line--;
-	Bungetrune(st->bp);
+	long m;
+
+	if(st->ep - st->rp >= n || st->eof)
+		return st->ep - st->rp;
+
+	line(st);
+	m = st->ep - st->rp;
+	memmove(st->buf, st->rp, m);
+	st->rp = st->lp = st->vp = st->buf;
+	st->ep = st->buf + m;
+	while(st->ep - st->rp < n){
+		m = read(st->fd, st->ep, st->buf + Nwin - st->ep);
+		if(m <= 0){
+			st->eof = 1;
+			if(st->debug == 1)
+				fprint(2, "EOF\n");
+			break;
+		}
+		if(st->debug == 3)
+			write(2, st->ep, m);
+		st->ep += m;
+	}
+	return st->ep - st->rp;
+}
+
+static int
+peek(State *st)
+{
+	if(st->rp >= st->ep && fill(st, 1) == 0)
+		return -1;
+	return *st->rp;
+}
+
+/*
+ * decode the rune under the cursor without consuming it,
+ * only multibyte sequences need real work. returns -2
+ * for a bad sequence, *np is then the bytes to skip.
+ */
+static long
+peekrune(State *st, int *np)
+{
+	int n;
+	Rune r;
+
+	if(st->rp >= st->ep && fill(st, 1) == 0)
+		return -1;
+	if(*st->rp < Runeself){
+		*np = 1;
+		return *st->rp;
+	}
+	if(st->rp < st->vp){
+		*np = chartorune(&r, (char *)st->rp);
+		return r;
+	}
+	n = fill(st, UTFmax);
+	if(! fullrune((char *)st->rp, n)){
+		/* cut short by EOF, skip only the lead byte */
+		*np = 1;
+		return -2;
+	}
+	*np = chartorune(&r, (char *)st->rp);
+	if(r == Runeerror && *np == 1)
+		return -2;
+	return r;
 }
 
 static long
 get(State *st)
 {
+	int n;
 	long r;
 
-	r = Bgetrune(st->bp);
-	if(r == Runeerror){
+	if((r = peekrune(st, &n)) == -1)
+		return -1;
+	st->rp += n;
+	if(r == -2){
 		failed(st, "bad UTF-8 sequence");
 		r = L' ';
 	}
-
-	if(r == L'\n')
-		st->line++;
-
-	if(xmldebug){
-		if(xmldebug == 3)
-			fprint(2, "%C", (Rune)r);
-		if(xmldebug == 1 && r == -1)
-			fprint(2, "EOF\n");
-	}
 	return r;
 }
 
@@ -155,35 +380,36 @@ static struct {
 	{ "nbsp",	0xa0 },		/* no-break space */
 };
 
+/*
+ * called with the cursor just past an '&'; if no ';'
+ * follows within Nref bytes the cursor is left alone.
+ */
 static long
 entityref(State *st)
 {
-	int n, i, l;
-	long r;
-	Rune x;
-	char *p, buf[Nref];
+	int i, l;
+	uchar *p, *e;
+	char buf[Nref];
 
-	l = 0;
-	p = buf;
-	while((r = get(st)) != -1 && r != L';' && ! isspacerune(r))
-		if(l < (sizeof(buf) - UTFmax)){
-			x = r;
-			n = runetochar(p, &x);
-			p += n;
-			l += n;
-		}
-	*p = 0;
-	if(r == -1)
-		return -1;
+	fill(st, Nref);
+	e = st->ep;
+	if(e - st->rp > Nref-1)
+		e = st->rp + Nref-1;
+	for(p = st->rp; p < e; p++)
+		if(*p == ';' || *p == '<' || *p == '&' || isspace(*p))
+			break;
 
 	/* false positive */
-	if(r != L';'){
-		fprint(2, "%d: unquoted '&' - ignored\n", st->line);
-		for(i = --l; i >= 0; i--)
-			unget(st, buf[i]);
+	if(p == e || *p != ';'){
+		fprint(2, "%d: unquoted '&' - ignored\n", line(st));
 		return L'&';
 	}
 
+	l = p - st->rp;
+	memmove(buf, st->rp, l);
+	buf[l] = 0;
+	st->rp = p+1;
+
 	if(buf[0] == '#'){
 		if(buf[1] == 'x' || buf[1] == 'X')
 			return strtol(buf+2, 0, 16);
@@ -191,31 +417,116 @@ entityref(State *st)
 	}
 
 	for(i = 0; i < nelem(Entities); i++)
-		if(memcmp(Entities[i].name, buf, l) == 0)
+		if(strcmp(Entities[i].name, buf) == 0)
 			return Entities[i].rune;
 
-	fprint(2, "%d: '&%s;' unknown/unsupported entity reference\n", st->line, buf);
+	fprint(2, "%d: '&%s;' unknown/unsupported entity reference\n", line(st), buf);
 	return L'?';
 }
 
+/*
+ * compare the input with s, consuming it only on a match
+ */
 static int
-match(State *st, Rune *s)
+match(State *st, char *s)
 {
-	long r;
-	Rune *p;
+	long n, m;
 
-	r = -1;
-	for(p = s; *p; p++)
-		if((r = get(st)) != *p)
-			break;
-	if(r == -1)
-		return -1;	/* EOF */
-	if(*p == 0)
-		return 0;	/* match */
-	unget(st, r);
-	for(p--; p >= s; p--)
-		unget(st, *p);
-	return 1;		/* no match */
+	n = strlen(s);
+	if((m = fill(st, n)) < n){
+		if(memcmp(st->rp, s, m) == 0)
+			return -1;	/* EOF */
+		return 1;
+	}
+	if(memcmp(st->rp, s, n) != 0)
+		return 1;		/* no match */
+	st->rp += n;
+	return 0;		/* match */
+}
+
+/*
+ * move the cursor past the next s, returns -1 on EOF
+ */
+static int
+skipto(State *st, char *s)
+{
+	uchar *p;
+
+	for(;;){
+		if((p = memchr(st->rp, s[0], st->ep - st->rp)) == nil){
+			st->rp = st->ep;
+			if(fill(st, 1) == 0)
+				return -1;
+			continue;
+		}
+		st->rp = p;
+		switch(match(st, s)){
+		case 0:
+			return 0;
+		case -1:
+			return -1;
+		}
+		st->rp++;
+	}
+}
+
+static int
+skipping(State *st, Elem *ep)
+{
+	int i;
+
+	for(i = 0; i < st->nskip; i++)
+		if(st->skip[i] == ep->atom)
+			return 1;
+	return 0;
+}
+
+/*
+ * pass over the contents of an element given to xmlskip,
+ * leaving the cursor after the "</" of its end tag as if
+ * they had been parsed. Only enough is looked at to keep
+ * count of nested elements. returns -1 on EOF.
+ */
+static int
+skipbody(State *st)
+{
+	int c, q, last, depth;
+
+	depth = 0;
+	for(;;){
+		if(skipto(st, "<") == -1)
+			return -1;
+		if(match(st, "/") == 0){
+			if(depth-- == 0)
+				return 0;
+			continue;
+		}
+		if(match(st, "!--") == 0)
+			c = skipto(st, "-->");
+		else if(match(st, "![CDATA[") == 0)
+			c = skipto(st, "]]>");
+		else if(match(st, "?") == 0 || match(st, "!") == 0)
+			c = skipto(st, ">");
+		else{
+			q = 0;
+			last = 0;
+			while((c = peek(st)) != -1){
+				st->rp++;
+				if(q){
+					if(c == q)
+						q = 0;
+				}else if(c == '"' || c == '\'')
+					q = c;
+				else if(c == '>')
+					break;
+				last = c;
+			}
+			if(c != -1 && last != '/')
+				depth++;
+		}
+		if(c == -1)
+			return -1;
+	}
 }
 
 static int
@@ -224,11 +535,11 @@ comment(State *st)
 	long r;
 	int startline;
 
-	startline = st->line;
+	startline = line(st);
 	do{
 		if(get(st) == -1)
 			break;
-	}while(match(st, L"--") == 1);
+	}while(match(st, "--") == 1);
 
 	r = get(st);
 	if(r == -1){
@@ -245,17 +556,18 @@ comment(State *st)
 static int
 doctype(State *st, Lexbuf *lb)
 {
+	int c;
 	long r;
 	char *p;
 	int startline;
 
-	startline = st->line;
+	startline = line(st);
 	
 	/* trim leading whitespace */
-	while((r = get(st)) != -1 && isspacerune(r))
-		continue;
-	unget(st, r);
+	while((c = peek(st)) != -1 && isspace(c))
+		st->rp++;
 
+	lb->n = 0;
 	if(lb->buf)
 		lb->buf[0] = 0;
 
@@ -267,11 +579,11 @@ doctype(State *st, Lexbuf *lb)
 		return -1;
 	}
 	/* trim trailing whitespace */
-	p = strrchr(lb->buf, 0);
-	for(p--; p >= lb->buf && isspace(*p); p--)
+	for(p = lb->buf + lb->n - 1; p >= lb->buf && isspace(*p); p--)
 		*p = 0;
+	lb->n = p+1 - lb->buf;
 
-	st->xml->doctype = xmlstrdup(st->xml, lb->buf, 0);
+	st->xml->doctype = xmlstrdup(st->xml, lb->buf? lb->buf: "", 0);
 	return Twhite;
 }
 
@@ -281,15 +593,14 @@ cdata(State *st, Lexbuf *lb)
 	long r;
 	int startline;
 
-	startline = st->line;
+	startline = line(st);
 	do{
 		if((r = get(st)) == -1)
 			break;
 		if(r == L'&')
-			if((r = entityref(st)) == -1)
-				break;
+			r = entityref(st);
 		growrune(st, lb, r);
-	}while(match(st, L"]]>") == 1);
+	}while(match(st, "]]>") == 1);
 
 	if(r == -1){
 		failed(st, "EOF in CDATA (re: line %d)", startline);
@@ -304,221 +615,807 @@ cdata(State *st, Lexbuf *lb)
  * and we don't support utf16 or utf32 but some xml seems to
  * prepend them to utf8 so we need to find them and skip them
  */
-static int
+static void
 bom(State *st)
 {
-	long r;
+	if(fill(st, 3) >= 3 && memcmp(st->rp, "\xef\xbb\xbf", 3) == 0)
+		st->rp += 3;
+}
 
-	if((r = get(st)) == -1)
-		return -1;
+/*
+ * copy text up to (but not including) the byte stop into lb,
+ * plain ASCII is found by _Xscan and multibyte sequences are
+ * checked Nvalid bytes at a time by _Xutf, so a span of good
+ * text is copied at once. Only entity references and bad or
+ * split sequences are handled singly. returns -1 on EOF.
+ */
+static int
+text(State *st, Lexbuf *lb, int stop)
+{
+	int n;
+	uchar *p, *e;
 
-	if(r != 0xbb){
-		unget(st, 0xef);
-		unget(st, r);
-		return -1;
-	}
-	if((r = get(st)) == -1){
-		unget(st, 0xef);
-		unget(st, 0xbb);
-		return -1;
+	for(;;){
+		e = st->ep;
+		p = st->rp;
+		for(;;){
+			p = _Xscan(p, e, stop, '&');
+			if(p == e || *p < Runeself)
+				break;
+			if(p >= st->vp)
+				st->vp = _Xutf(p, e-p > Nvalid? p+Nvalid: e);
+			if(p == st->vp)
+				break;
+			p += Utflen(*p);
+		}
+		growspan(st, lb, (char *)st->rp, p - st->rp);
+		st->rp = p;
+		if(p == e){
+			if(fill(st, 1) == 0)
+				return -1;
+			continue;
+		}
+		if(*p == stop)
+			return 0;
+		switch(*p){
+		case '&':
+			st->rp++;
+			growrune(st, lb, entityref(st));
+			break;
+		case 0:
+			st->rp++;
+			break;
+		default:
+			if(peekrune(st, &n) == -2){
+				growrune(st, lb, get(st));
+				break;
+			}
+			growspan(st, lb, (char *)st->rp, n);
+			st->rp += n;
+			break;
+		}
 	}
-	if(r != 0xbf){
-		unget(st, 0xef);
-		unget(st, 0xbb);
-		unget(st, r);
+}
+
+/*
+ * The lexer and the parser's tables run as one automaton:
+ * for each parser state, lexer state and class of the byte
+ * under the cursor, dfa says what to scan and, where that
+ * fixes the token, the parser's next state and action, so
+ * a token costs one lookup. It is built by mkdfa from the
+ * tables in state-machine.h, which stay the description of
+ * the grammar. Names, values and text are still scanned a
+ * span at a time.
+ */
+enum {			/* byte classes */
+	Cname = 0,	/* none of the below: a name, or text */
+	Clt,
+	Cgt,
+	Ceq,
+	Cslash,
+	Cquote,
+	Cspace,
+	Cvt,		/* \v, white in a tag but not after '<' */
+	Cbang,
+	Cquest,
+	Nclass,
+};
+
+enum {			/* lexer states */
+	Lstart = 0,
+	Lopen,		/* after '<' */
+	Nlex,
+};
+
+enum {			/* what to do with the byte */
+	Mstep = 0,	/* take it and go to lexer state Lopen */
+	Mone,		/* take it, it is the token */
+	Mkeep,		/* leave it, the token is already known */
+	Mname,		/* a name */
+	Mvalue,		/* a quoted value */
+	Mtext,		/* pcdata up to '<' */
+	Mwhite,		/* white space in a tag */
+	Mslash,		/* '/' in a tag, "/>" or nothing */
+	Mpi,		/* <?...> */
+	Mbang,		/* comment, DOCTYPE or CDATA, which decide the token */
+	Mspace,		/* white space after '<' */
+};
+
+typedef struct {
+	uchar scan;	/* M* */
+	uchar tok;
+	uchar next;	/* parser state after tok */
+	uchar act;	/* and what to do */
+} Move;
+
+static uchar bclass[256];
+static Move dfa[NumStates][Nlex][Nclass];
+static Move tokmove[NumStates][NumToks];	/* tokens the scanner decides */
+static int dfaready;
+static Lock dfalock;
+
+static void
+setmove(Move *m, int scan, int s, int t)
+{
+	*m = tokmove[s][t];
+	m->scan = scan;
+}
+
+static void
+mkdfa(void)
+{
+	int s, t, k;
+	char *p;
+	Move *m;
+
+	lock(&dfalock);
+	if(dfaready){
+		unlock(&dfalock);
+		return;
 	}
-	return 0;
+	bclass['<'] = Clt;
+	bclass['>'] = Cgt;
+	bclass['='] = Ceq;
+	bclass['/'] = Cslash;
+	bclass['\''] = Cquote;
+	bclass['"'] = Cquote;
+	for(p = " \t\n\r\f"; *p; p++)
+		bclass[*p] = Cspace;
+	bclass['\v'] = Cvt;
+	bclass['!'] = Cbang;
+	bclass['?'] = Cquest;
+
+	for(s = 0; s < NumStates; s++)
+		for(t = 0; t < NumToks; t++){
+			m = &tokmove[s][t];
+			m->scan = Mkeep;
+			m->tok = t;
+			m->next = statab[s][t];
+			m->act = acttab[s][t];
+		}
+
+	for(s = 0; s < NumStates; s++)
+		for(k = 0; k < Nclass; k++){
+			m = &dfa[s][Lstart][k];
+			if(k == Clt)
+				m->scan = Mstep;
+			else if(s == Slost)
+				setmove(m, Mtext, s, Tname);
+			else switch(k){
+			case Cgt:
+				setmove(m, Mone, s, Tclose);
+				break;
+			case Ceq:
+				setmove(m, Mone, s, Tequal);
+				break;
+			case Cslash:
+				m->scan = Mslash;
+				break;
+			case Cquote:
+				setmove(m, Mvalue, s, Tname);
+				break;
+			case Cspace:
+			case Cvt:
+				setmove(m, Mwhite, s, Twhite);
+				break;
+			default:
+				setmove(m, Mname, s, Tname);
+				break;
+			}
+
+			m = &dfa[s][Lopen][k];
+			switch(k){
+			case Cquest:
+				setmove(m, Mpi, s, Twhite);
+				break;
+			case Cbang:
+				m->scan = Mbang;
+				break;
+			case Cslash:
+				setmove(m, Mone, s, Tendblk);
+				break;
+			case Cspace:
+				m->scan = Mspace;
+				break;
+			default:
+				setmove(m, Mkeep, s, Topen);
+				break;
+			}
+		}
+	dfaready = 1;
+	unlock(&dfalock);
 }
 
-static int
+/*
+ * the next token as the move it makes from parser state
+ * s, nil at EOF
+ */
+static Move *
 xlex(State *st, Lexbuf *lb, int s)
 {
+	int c, n, l, t;
 	long r;
-	Rune q;
-
-	while((r = get(st)) != -1){
-		if(r == 0xef)
-			if(bom(st) == 0)
-				continue;
-		if(r == L'<'){
-			r = get(st);
-			switch(r){
-			case L'?':
-				while((r = get(st)) != -1 && r != L'>')
-					continue;
-				if(r == -1)
-					return -1;
-				return Twhite;
-			case L'!':
-				if(match(st, L"--") == 0)
-					return comment(st);
-				if(match(st, L"DOCTYPE ") == 0)
-					return doctype(st, lb);
-				if(match(st, L"[CDATA[") == 0)
-					return cdata(st, lb);
+	uchar *p;
+	Move *m;
+
+	l = Lstart;
+	for(;;){
+		if((c = peek(st)) == -1){
+			if(l == Lstart)
+				return nil;
+			c = 0;		/* "<" at EOF is an open */
+		}
+		m = &dfa[s][l][bclass[c]];
+		switch(m->scan){
+		case Mstep:
+			st->rp++;
+			l = Lopen;
+			continue;
+		case Mone:
+			st->rp++;
+			return m;
+		case Mkeep:
+			return m;
+		case Mname:
+			growrune(st, lb, get(st));
+			for(;;){
+				for(p = st->rp; p < st->ep && *p < Runeself; p++)
+					if(! isnameN(*p))
+						break;
+				growspan(st, lb, (char *)st->rp, p - st->rp);
+				st->rp = p;
+				if((r = peekrune(st, &n)) == -1)
+					return nil;
+				if(! isnameN(r))
+					break;
+				growrune(st, lb, get(st));
+			}
+			return m;
+		case Mvalue:
+			st->rp++;
+			if(text(st, lb, c) == -1)
+				return nil;
+			st->rp++;
+			return m;
+		case Mtext:
+			/*
+			 * a part, or an element's contents (base > 0),
+			 * ends in text, which must not be lost
+			 */
+			if(text(st, lb, '<') == -1 && (st->top == nil && st->base == 0 || lb->n == 0))
+				return nil;
+			return m;
+		case Mwhite:
+			while((r = peekrune(st, &n)) != -1 && isspacerune(r)){
+				growspan(st, lb, (char *)st->rp, n);
+				st->rp += n;
+			}
+			if(r == -1)
+				return nil;
+			return m;
+		case Mslash:
+			st->rp++;
+			if(peek(st) == '>'){
+				st->rp++;
+				return &tokmove[s][Tnulblk];
+			}
+			l = Lstart;
+			continue;
+		case Mpi:
+			while((c = peek(st)) != -1 && c != '>')
+				st->rp++;
+			if(c == -1)
+				return nil;
+			st->rp++;
+			return m;
+		case Mbang:
+			st->rp++;
+			if(match(st, "--") == 0)
+				t = comment(st);
+			else if(match(st, "DOCTYPE ") == 0)
+				t = doctype(st, lb);
+			else if(match(st, "[CDATA[") == 0)
+				t = cdata(st, lb);
+			else{
 				failed(st, "<!name not known");
-			case L'/':
-				return Tendblk;
-			case L' ':
-			case L'\t':
-			case L'\f':
-			case L'\n':
-			case L'\r':
-				failed(st, "whitespace following '<'");
-				break;
-			default:
-				unget(st, r);
-				return Topen;
+				t = Tendblk;
 			}
+			if(t == -1)
+				return nil;
+			return &tokmove[s][t];
+		case Mspace:
+			st->rp++;
+			failed(st, "whitespace following '<'");
+			l = Lstart;
 			continue;
 		}
+	}
+}
 
-		if(s != Slost){
-			switch(r){
-			case '=':
-				return Tequal;
-			case '>':
-				return Tclose;
-			case '/':
-				r = get(st);
-				if(r == '>')
-					return Tnulblk;
-				unget(st, r);
-				continue;
-			case '\'':
-			case '"':		/* attribute value */
-				q = r;
-				while((r = get(st)) != -1 && r != q){
-					if(r == L'&')
-						if((r = entityref(st)) == -1)
-							break;
-					growrune(st, lb, r);
-				}
-				if(r == -1)
-					return -1;
-				return Tname;
-			case '\n':
-			case '\r':
-			case ' ':
-			case '\v':
-			case '\f':
-			case '\t':
-				do
-					growrune(st, lb, r);
-				while((r = get(st)) != -1 && isspacerune(r));
-				if(r == -1)
-					return -1;
-				unget(st, r);
-				return Twhite;
-			default:		/* attribute name */
-				do
-					growrune(st, lb, r);
-				while((r = get(st)) != -1 && isnameN(r));
-				if(r == -1)
-					return -1;
-				unget(st, r);
-				return Tname;
-			}
+/*
+ * Tree building, or event delivery if st->sax is set.
+ * In event mode nodes live in the driver's stack frame
+ * and only their interned names outlive them.
+ */
+static Elem *
+opened(State *st, Elem **root, Elem *parent, Elem *scratch, char *name)
+{
+	Elem *ep;
+
+	if(st->sax == nil){
+		assert((ep = xmlelem(st->xml, root, parent, nil)) != nil);
+		/* ns holds the prefix until resolve */
+		if(st->flags & Fstripnamespace){
+			_Xinternq(st->xml, name, nil, &ep->ns, &ep->local, &ep->name);
+			ep->atom = ep->local;
+		}else
+			ep->name = _Xinternq(st->xml, name, &ep->atom, &ep->ns, &ep->local, nil);
+		ep->line = line(st);
+		return ep;
+	}
+	ep = scratch;
+	memset(ep, 0, sizeof(Elem));
+	ep->parent = parent;
+	if(st->flags & Fstripnamespace)
+		name = localname(name);
+	ep->name = _Xintern(st->xml, name, &ep->atom);
+	ep->line = line(st);
+	if(st->sax->start)
+		st->sax->start(st->sax, ep->name, ep->atom, ep->line);
+	return ep;
+}
+
+static void
+closed(State *st, Elem *ep)
+{
+	if(st->sax && st->sax->end)
+		st->sax->end(st->sax, ep->name);
+}
+
+static Attr *
+attr(State *st, Attr **root, Elem *ep, Attr *scratch, char *name)
+{
+	Attr *ap;
+
+	if(st->sax == nil){
+		assert((ap = xmlattr(st->xml, root, ep, nil, nil)) != nil);
+		if(st->flags & Fstripnamespace){
+			_Xinternq(st->xml, name, nil, &ap->ns, &ap->local, &ap->name);
+			ap->atom = ap->local;
+		}else
+			ap->name = _Xinternq(st->xml, name, &ap->atom, &ap->ns, &ap->local, nil);
+		return ap;
+	}
+	ap = scratch;
+	memset(ap, 0, sizeof(Attr));
+	ap->parent = ep;
+	if(st->flags & Fstripnamespace)
+		name = localname(name);
+	ap->name = _Xintern(st->xml, name, &ap->atom);
+	return ap;
+}
+
+static void
+value(State *st, Attr *ap, char *val)
+{
+	if(st->sax){
+		if(st->sax->attr)
+			st->sax->attr(st->sax, ap->name, ap->atom, val);
+		return;
+	}
+	if(st->nnum && _Xnumvalue(st->xml, st->num, st->nnum, ap, val) == 0)
+		return;
+	if((st->flags & Fintern) == 0 || (ap->value = _Xinternval(st->xml, val)) == nil)
+		ap->value = xmlstrdup(st->xml, val, 0);
+}
+
+/*
+ * Namespaces. Prefixes declared by xmlns attributes are
+ * kept on a stack while their element is open; once an
+ * element's start tag is read the prefixes of it and its
+ * attributes are looked up and replaced by the URIs they
+ * stand for. Both are atoms, so a name is matched by
+ * comparing its ns and local with two integer compares.
+ */
+static void
+nsinit(State *st)
+{
+	st->axml = xmlatom("xml");
+	st->axmlns = xmlatom("xmlns");
+	st->nsxml = xmlatom("http://www.w3.org/XML/1998/namespace");
+	st->nbind = 0;
+}
+
+static void
+bind(State *st, int prefix, int ns, int depth)
+{
+	Bind *b;
+
+	if(st->nbind == st->maxbind){
+		st->maxbind = st->maxbind? st->maxbind*2: 32;
+		if((st->bind = realloc(st->bind, st->maxbind * sizeof(Bind))) == nil)
+			sysfatal("xmlparse: no memory for namespaces\n");
+	}
+	b = &st->bind[st->nbind++];
+	b->prefix = prefix;
+	b->ns = ns;
+	b->depth = depth;
+}
+
+/*
+ * forget the prefixes declared by the element at depth
+ */
+static void
+unbind(State *st, int depth)
+{
+	while(st->nbind > 0 && st->bind[st->nbind-1].depth >= depth)
+		st->nbind--;
+}
+
+static int
+nsof(State *st, int prefix)
+{
+	Bind *b;
+
+	for(b = st->bind + st->nbind; b > st->bind; )
+		if((--b)->prefix == prefix)
+			return b->ns;
+	if(prefix == st->axml)
+		return st->nsxml;
+	return 0;
+}
+
+/*
+ * declare the namespaces in ep's attributes and resolve the
+ * prefixes left in the ns fields by opened and attr.
+ */
+static void
+resolve(State *st, Elem *ep, int depth)
+{
+	int ns;
+	Attr *ap;
+
+	for(ap = ep->attrs; ap; ap = ap->next)
+		if((ap->atom == st->axmlns || ap->ns == st->axmlns) && ap->value){
+			ns = 0;
+			if(*ap->value)
+				_Xintern(st->xml, ap->value, &ns);
+			bind(st, ap->ns == st->axmlns? ap->local: 0, ns, depth);
 		}
+	ep->ns = nsof(st, ep->ns);
+	for(ap = ep->attrs; ap; ap = ap->next)
+		if(ap->ns)
+			ap->ns = ap->ns == st->axmlns? 0: nsof(st, ap->ns);
+}
 
-		do{
-			if(r == L'&')
-				if((r = entityref(st)) == -1)
-					break;
-			growrune(st, lb, r);
-		}while((r = get(st)) != -1 && r != '<');
-		if(r == -1)
-			return -1;
-		unget(st, r);
-		return Tname;
+/*
+ * declare the namespaces in the start tag at p, one
+ * of a part's ancestors which its parser never sees.
+ */
+static void
+tagbind(State *st, uchar *p, uchar *e)
+{
+	int c, n, prefix, ns;
+	uchar *name, *v;
+	char buf[Ntext];
+
+	for(p++; p < e && *p != '>' && !isspace(*p); p++)
+		;
+	for(;;){
+		while(p < e && isspace(*p))
+			p++;
+		name = p;
+		while(p < e && *p != '=' && *p != '>' && !isspace(*p))
+			p++;
+		n = p - name;
+		while(p < e && isspace(*p))
+			p++;
+		if(p >= e || *p++ != '=')
+			return;
+		while(p < e && isspace(*p))
+			p++;
+		if(p >= e || (*p != '"' && *p != '\''))
+			return;
+		c = *p++;
+		v = p;
+		if((p = memchr(p, c, e-p)) == nil)
+			return;
+		p++;
+		if(n < 5 || memcmp(name, "xmlns", 5) != 0 || (n > 5 && name[5] != ':'))
+			continue;
+		prefix = 0;
+		if(n > 6){
+			snprint(buf, sizeof(buf), "%.*s", n-6, (char *)name+6);
+			prefix = xmlatom(buf);
+		}
+		snprint(buf, sizeof(buf), "%.*s", (int)(p-1-v), (char *)v);
+		ns = 0;
+		if(buf[0])
+			_Xintern(st->xml, buf, &ns);
+		bind(st, prefix, ns, -1);
 	}
-	return -1;
+}
+
+/*
+ * parent's pcdata is what's in pc from start on, hand it
+ * over and give the space back
+ */
+static void
+pcdata(State *st, Elem *parent, Lexbuf *pc, int start)
+{
+	if(pc->n == start)
+		return;
+	if(st->sax == nil){
+		parent->pcdata = xmlstrdup(st->xml, pc->buf+start, 0);
+		st->xml->stats.texts++;
+	}
+	else if(st->sax->text)
+		st->sax->text(st->sax, pc->buf+start);
+	pc->n = start;
+	pc->buf[start] = 0;
+}
+
+/*
+ * pcdata at the top level of a part belongs to an element
+ * in the main parse, keep it to be added there in order.
+ */
+static void
+keepfrag(State *st, char *str)
+{
+	Frag *f;
+
+	if(str == nil || *str == 0)
+		return;
+	if((f = malloc(sizeof(Frag) + strlen(str))) == nil)
+		sysfatal("xmlparse: no memory for pcdata\n");
+	strcpy(f->str, str);
+	f->next = nil;
+	*st->ftail = f;
+	st->ftail = &f->next;
+}
+
+/*
+ * the main parse has reached the start of a part, link its
+ * elements in after fr's last and carry on from the end of it.
+ */
+static void
+joinpart(State *st, Frame *fr, Lexbuf *pc, int depth)
+{
+	Part *p;
+	Frag *f;
+	Elem *ep;
+	Xstats *a, *b;
+
+	p = st->part++;
+	if(st->part == st->epart)
+		st->part = nil;
+
+	a = &st->xml->stats;
+	b = &p->xml->stats;
+	a->lookups += b->lookups;
+	a->hits += b->hits;
+	a->elems += b->elems;
+	a->attrs += b->attrs;
+	a->texts += b->texts;
+	a->skipped += b->skipped;
+	a->shared += b->shared;
+	if(b->maxdepth + st->base+depth > a->maxdepth)
+		a->maxdepth = b->maxdepth + st->base+depth;
+
+	/* text outside the root is dropped, as in a serial parse */
+	for(f = p->frags; f && fr->parent; f = f->next)
+		growstr(st, pc, fr->pc, f->str, strlen(f->str));
+	if(p->root){
+		if(fr->ep)
+			fr->ep->next = p->root;
+		else
+			fr->root = p->root;
+		for(ep = p->root; ; ep = ep->next){
+			ep->parent = fr->parent;
+			if(ep->next == nil)
+				break;
+		}
+		fr->ep = ep;
+	}
+	st->rp = st->lp = p->end;
+	st->line = p->endline;
+}
+
+/*
+ * note where ep's contents are and pass over them, to be
+ * parsed by xmlchild if anyone asks.
+ */
+static void
+defer(State *st, Elem *ep, int depth)
+{
+	int ln;
+	uchar *start;
+	Xlazy *lz;
+
+	start = st->rp;
+	ln = line(st);
+	if(skipbody(st) == -1)
+		return;
+	if(st->rp-2 == start)
+		return;
+	lz = xmlmalloc(st->xml, sizeof(Xlazy) + st->nbind * sizeof(Bind));
+	lz->xml = st->xml;
+	lz->start = start;
+	lz->end = st->rp-2;
+	lz->line = ln;
+	lz->base = st->base+depth+1;
+	lz->flags = st->flags & ~Flazy;
+	lz->nbind = st->nbind;
+	if(st->nbind)
+		memmove(lz->bind, st->bind, st->nbind * sizeof(Bind));
+	ep->lazy = lz;
+}
+
+/*
+ * the contents of fr->parent are done: give it its pcdata
+ * and children and go back up to its own level
+ */
+static Frame *
+up(State *st, Frame *fr, Lexbuf *pc, int depth)
+{
+	Elem *ep;
+
+	pcdata(st, fr->parent, pc, fr->pc);
+	ep = fr->parent;
+	ep->child = fr->root;
+	fr = fr->up;
+	unbind(st, depth-1);
+	if(st->debug == 1 && ep->pcdata)
+		fprint(2, "%*.s     name=%s pcdata len=%ld\n", 
+			depth-1, "",
+			ep->name,
+			(ep->pcdata)? strlen(ep->pcdata): 0L);
+	return fr;
 }
 
 static Elem *
 _xmlparse(State *st, Elem *parent, int depth)
 {
-	Attr *ap;
+	Attr *ap, *atail, sattr;
 	Lexbuf lexbuf, *lb;
-	Lexbuf pcdata, *pc;
-	Elem *root, *ep;
-	int os, s, t, a;
+	Lexbuf pcbuf, *pc;
+	Frame base, *fr, *nf;
+	Elem *ep;
+	Move *m;
+	int os, t, a;
+	char *name;
 
+	/*
+	 * fr->ep is always the last element at this level and
+	 * atail its last attribute, appending through their next
+	 * pointers keeps tree building linear in the size of the
+	 * document. One token buffer and one pcdata buffer serve
+	 * the whole parse, each level's pcdata above its parent's.
+	 */
 	ap = nil;
-	ep = nil;
-	s = Slost;
-	root = nil;
+	atail = nil;
 	lb = &lexbuf;
 	memset(lb, 0, sizeof(Lexbuf));
-	pc = &pcdata;
+	grow(lb, Grain);
+	pc = &pcbuf;
 	memset(pc, 0, sizeof(Lexbuf));
-	while((t = xlex(st, lb, s)) != -1){
-		os = s;
-		s = statab[os][t];
-		a = acttab[os][t];
-		if(xmldebug == 2)
+	grow(pc, Grain);
+	memset(&base, 0, sizeof(Frame));
+	base.parent = parent;
+	base.s = Slost;
+	fr = &base;
+	for(;;){
+		if(st->xml->nomem){
+			/* the tree will be thrown away, unwind at once */
+			failed(st, "out of memory");
+			pc->n = 0;
+			goto done;
+		}
+		while(st->part && st->rp == st->part->start && fr->s == Slost)
+			joinpart(st, fr, pc, depth);
+		if((m = xlex(st, lb, fr->s)) == nil)
+			break;
+		os = fr->s;
+		t = m->tok;
+		fr->s = m->next;
+		a = m->act;
+		ep = fr->ep;
+		if(st->debug == 2)
 			fprint(2, "depth=%d token=%s action=%s state=%s->%s str='%s'\n",
-				depth, tokstr[t], actstr[a], stastr[os], stastr[s], lb->buf);
+				depth, tokstr[t], actstr[a], stastr[os], stastr[fr->s], lb->buf);
 		switch(a){
 		case Aelem:
-			if(xmldebug == 1)
-				fprint(2, "%-3d %*.selem name='%s'\n", st->line, depth, "", lb->buf);
+			if(st->debug == 1)
+				fprint(2, "%-3d %*.selem name='%s'\n", line(st), depth, "", lb->buf);
 			if(!isname1(lb->buf[0]))
 				failed(st, "'%s' is an illegal element name", lb->buf);
-			if(st->flags & Fstripnamespace)
-				stripns(lb->buf);
-			assert((ep = xmlelem(st->xml, &root, parent, lb->buf)) != nil);
-			ep->line = st->line;
+			fr->ep = opened(st, ep? &ep->next: &fr->root, fr->parent, &fr->selem, lb->buf);
+			atail = nil;
+			if(st->base+depth+1 > st->xml->stats.maxdepth)
+				st->xml->stats.maxdepth = st->base+depth+1;
 			break;
 		case Apcdata:
-			if(parent)
-				growstr(st, pc, lb->buf);
+			if(fr->parent == nil)
+				break;
+			if(fr->parent == st->top)
+				keepfrag(st, lb->buf);
+			else
+				growstr(st, pc, fr->pc, lb->buf, lb->n);
 			break;
 		case Aattr:
 			assert(ep != nil);
-			if(xmldebug == 1)
-				fprint(2, "%-3d %*.sattr name='%s'\n", st->line, depth, "", lb->buf);
+			if(st->debug == 1)
+				fprint(2, "%-3d %*.sattr name='%s'\n", line(st), depth, "", lb->buf);
 			if(!isname1(lb->buf[0]))
 				failed(st, "'%s' is an illegal attribute name", lb->buf);
-			if(st->flags & Fstripnamespace)
-				stripns(lb->buf);
-			assert((ap = xmlattr(st->xml, &(ep->attrs), ep, lb->buf, nil)) != nil);
+			ap = attr(st, atail? &atail->next: &ep->attrs, ep, &sattr, lb->buf);
+			atail = ap;
 			break;
 		case Avalue:
 			assert(ep != nil);
 			assert(ap != nil);
-			ap->value = xmlstrdup(st->xml, lb->buf, 0);
+			value(st, ap, lb->buf);
 			ap = nil;
-			if(xmldebug == 1)
+			if(st->debug == 1)
 				fprint(2, "%*.sattr value=%s\n", depth, "", lb->buf);
 			break;
 		case Adown:
 			assert(ep != nil);
-			if(xmldebug == 1)
+			if(st->debug == 1)
 				fprint(2, "%*.sdown name=%s\n", depth, "", ep->name);
-			ep->child = _xmlparse(st, ep, depth+1);
-			if(xmldebug == 1 && ep->pcdata)
+			if(st->sax == nil)
+				resolve(st, ep, depth);
+			if(skipping(st, ep)){
+				if(skipbody(st) == -1)
+					failed(st, "unexpected EOF (depth=%d)", depth+1);
+				st->xml->stats.skipped++;
+			}else if(st->flags & Flazy && depth == 1 && st->sax == nil)
+				defer(st, ep, depth);
+			else{
+				if(fr->down == nil){
+					if((nf = mallocz(sizeof(Frame), 1)) == nil)
+						sysfatal("xmlparse: no memory for depth %d\n", depth);
+					nf->up = fr;
+					fr->down = nf;
+				}
+				fr = fr->down;
+				fr->parent = ep;
+				fr->root = nil;
+				fr->ep = nil;
+				fr->s = Slost;
+				fr->pc = pc->n;
+				depth++;
+				break;
+			}
+			unbind(st, depth);
+			if(st->debug == 1 && ep->pcdata)
 				fprint(2, "%*.s     name=%s pcdata len=%ld\n", 
 					depth, "",
 					ep->name,
 					(ep->pcdata)? strlen(ep->pcdata): 0L);
 			break;
 		case Aup:
-			if(pc->buf){
-				parent->pcdata = xmlstrdup(st->xml, pc->buf, 0);
-				free(pc->buf);
-			}
-			free(lb->buf);
-			return root;
-			/* NOTREACHED */
+			if(fr == &base)
+				goto done;
+			fr = up(st, fr, pc, depth--);
 			break;
 		case Acheck:
 			assert(ep != nil);
+			name = lb->buf;
 			if(st->flags & Fstripnamespace)
-				stripns(lb->buf);
-			if(ep->name && strcmp(lb->buf, ep->name) != 0)
+				name = localname(name);
+			if(ep->name && strcmp(name, ep->name) != 0)
 				failed(st, "</%s> found, expecting match for <%s> (re: line %d) - nesting error",
-					lb->buf, ep->name, ep->line);
+					name, ep->name, ep->line);
+			closed(st, ep);
+			break;
+		case Aempty:
+			assert(ep != nil);
+			if(st->sax == nil){
+				resolve(st, ep, depth);
+				unbind(st, depth);
+			}
+			closed(st, ep);
 			break;
 		case Anop:
 			break;
@@ -529,42 +1426,424 @@ _xmlparse(State *st, Elem *parent, int depth)
 			sysfatal("xmlparse: %d - internal error, unknown action\n", a);
 			break;
 		}
-		if(lb->buf)
-			lb->buf[0] = 0;
+		lb->n = 0;
+		lb->buf[0] = 0;
 	}
-	if(t == -1 && depth != 0)
-		failed(st, "unexpected EOF (depth=%d)", depth);
 
-	if(pc->buf){
-		parent->pcdata = xmlstrdup(st->xml, pc->buf, 0);
-		free(pc->buf);
+	/* EOF, close whatever is open */
+	for(;;){
+		if(depth != 0)
+			failed(st, "unexpected EOF (depth=%d)", depth);
+		if(fr->parent && fr->parent == st->top && fr->s != Slost)
+			failed(st, "part ends inside a tag");
+		if(fr == &base)
+			break;
+		fr = up(st, fr, pc, depth--);
+	}
+done:
+	pcdata(st, parent, pc, 0);
+	if(st->xml->nomem && !st->failed)
+		failed(st, "out of memory");
+	for(fr = base.down; fr; fr = nf){
+		nf = fr->down;
+		free(fr);
 	}
 	free(lb->buf);
-	return root;
+	free(pc->buf);
+	return base.root;
+}
+
+/*
+ * for input already in memory
+ */
+static void
+setupmem(State *st, Xml *x, uchar *buf, uchar *e, int line, int flags)
+{
+	mkdfa();
+	memset(st, 0, sizeof(State));
+	st->xml = x;
+	st->debug = x->debug;
+	st->line = line;
+	st->fd = -1;
+	st->buf = st->rp = st->lp = buf;
+	st->ep = e;
+	st->eof = 1;
+	st->flags = flags;
+	st->skip = x->skip;
+	st->nskip = x->nskip;
+	st->num = x->num;
+	st->nnum = x->nnum;
+	nsinit(st);
+}
+
+static void
+setup(State *st, Xml *x, int fd, int flags)
+{
+	mkdfa();
+	memset(st, 0, sizeof(State));
+	st->xml = x;
+	st->debug = x->debug;
+	st->line = 1;
+	st->fd = fd;
+	if((st->buf = malloc(Nwin)) == nil)
+		sysfatal("xmlparse: no memory for input window\n");
+	st->rp = st->ep = st->lp = st->buf;
+	st->flags = flags;
+	st->skip = x->skip;
+	st->nskip = x->nskip;
+	st->num = x->num;
+	st->nnum = x->nnum;
+	nsinit(st);
+	bom(st);
+}
+
+static uchar *
+slurp(int fd, long *np)
+{
+	long n, m, sz;
+	uchar *buf;
+
+	n = 0;
+	sz = 0;
+	buf = nil;
+	for(;;){
+		if(n == sz){
+			sz = sz? sz*2: Nwin;
+			if((buf = realloc(buf, sz)) == nil)
+				sysfatal("xmlparse: no memory for input\n");
+		}
+		if((m = read(fd, buf+n, sz-n)) <= 0)
+			break;
+		n += m;
+	}
+	*np = n;
+	return buf;
+}
+
+static int
+lines(uchar *p, uchar *e)
+{
+	int n;
+
+	n = 0;
+	for(; (p = memchr(p, '\n', e-p)) != nil; p++)
+		n++;
+	return n;
+}
+
+static void
+work(Part *p, int flags)
+{
+	int i;
+	State s;
+	Elem top;
+	uchar **a;
+
+	setupmem(&s, p->xml, p->start, p->end, p->line, flags);
+	s.skip = p->skip;
+	s.nskip = p->nskip;
+	s.num = p->num;
+	s.nnum = p->nnum;
+	for(i = 0; i < p->nctx; i++)
+		bind(&s, p->ctx[i].prefix, p->ctx[i].ns, -1);
+	for(a = p->anc; *a; a++)
+		tagbind(&s, *a, p->start);
+	memset(&top, 0, sizeof(Elem));
+	s.top = &top;
+	s.ftail = &p->frags;
+	p->root = _xmlparse(&s, &top, 0);
+	free(s.bind);
+	p->ok = !s.failed && s.rp == s.ep && p->xml->doctype == nil;
+}
+
+/*
+ * run work on p in a new proc, or in this one if there are
+ * none to be had. The new proc holds a copy of sync, the
+ * write end of a pipe nothing is written to; it is closed
+ * when the proc exits, however it goes, so the parent
+ * waits for its parts by reading to end of file rather
+ * than with waitpid, which could reap a child of our
+ * caller's.
+ */
+static void
+spawn(Part *p, int flags, int *sync)
+{
+	switch(rfork(RFPROC|RFMEM|RFFDG|RFNOWAIT)){
+	case -1:
+		work(p, flags);
+		break;
+	case 0:
+		close(sync[0]);
+		work(p, flags);
+		_exits(nil);
+	}
+}
+
+/*
+ * parse buf..ebuf, starting on the given line, as the
+ * contents of parent or as a whole document if parent is
+ * nil, with Fparallel in up to $NPROC pieces at once.
+ * ctx holds the namespace prefixes in scope and base is
+ * the depth of parent. The pieces are parsed first, then
+ * the main parse runs over everything else, splicing in
+ * each piece as it reaches it. If any piece fails it is
+ * all parsed again serially to report the error properly.
+ */
+static int
+parserange(Xml *x, Elem *parent, uchar *buf, uchar *ebuf, int line, Bind *ctx, int nctx, int base, int flags)
+{
+	int i, n, nproc, ok, sync[2];
+	long len;
+	uchar *p, *cut[Npart+1], *anc[8];
+	char *e, c;
+	Part *part;
+	Frag *f, *nf;
+	Elem *root;
+	State s;
+
+	len = ebuf - buf;
+	nproc = 1;
+	if((flags & Fparallel) && (e = getenv("NPROC")) != nil){
+		nproc = atoi(e);
+		free(e);
+	}
+	if(nproc > Npart)
+		nproc = Npart;
+	if(nproc > len/Minpart)
+		nproc = len/Minpart;
+
+	n = 0;
+	if(x->debug == 0 && nproc > 1)
+		n = _Xsplit(buf, ebuf, cut, nproc, anc);
+	part = nil;
+	if(n > 0 && (part = mallocz(n * sizeof(Part), 1)) == nil)
+		sysfatal("xmlparse: no memory for parts\n");
+
+	p = buf;
+	for(i = 0; i < n; i++){
+		line += lines(p, cut[i]);
+		p = cut[i];
+		part[i].start = cut[i];
+		part[i].end = cut[i+1];
+		part[i].line = line;
+		part[i].anc = anc;
+		part[i].ctx = ctx;
+		part[i].nctx = nctx;
+		part[i].skip = x->skip;
+		part[i].nskip = x->nskip;
+		part[i].num = x->num;
+		part[i].nnum = x->nnum;
+		if(i > 0)
+			part[i-1].endline = line;
+		if((part[i].xml = xmlnewalloc(x->alloc.blksiz, x->alloc.a)) == nil)
+			sysfatal("xmlparse: no memory for parts\n");
+		part[i].xml->debug = x->debug;
+	}
+	if(n > 0)
+		part[n-1].endline = line + lines(p, cut[n]);
+
+	/* the last part is ours; a part whose proc dies is not ok */
+	if(n > 0){
+		if(pipe(sync) == -1)
+			sysfatal("xmlparse: pipe: %r");
+		for(i = 0; i < n-1; i++)
+			spawn(&part[i], flags, sync);
+		close(sync[1]);
+		work(&part[n-1], flags);
+		while(read(sync[0], &c, 1) > 0)
+			;
+		close(sync[0]);
+	}
+
+	if(n > 0)
+		line = part[0].line - lines(buf, cut[0]);
+	setupmem(&s, x, buf, ebuf, line, flags);
+	s.base = base;
+	for(i = 0; i < nctx; i++)
+		bind(&s, ctx[i].prefix, ctx[i].ns, -1);
+	for(i = 0; i < n; i++)
+		if(! part[i].ok)
+			break;
+	ok = n > 0 && i == n;
+	if(ok){
+		s.part = part;
+		s.epart = part+n;
+	}
+	if(parent == nil)
+		bom(&s);
+
+	root = _xmlparse(&s, parent, 0);
+	if(parent)
+		parent->child = root;
+	else
+		x->root = root;
+	free(s.bind);
+
+	/* the tree holds the parts' nodes only if they were spliced in */
+	for(i = 0; i < n; i++){
+		if(ok)
+			_Xheapjoin(x, part[i].xml);
+		xmlfree(part[i].xml);
+	}
+
+	for(i = 0; i < n; i++)
+		for(f = part[i].frags; f; f = nf){
+			nf = f->next;
+			free(f);
+		}
+	free(part);
+	return s.failed? -1: 0;
+}
+
+/*
+ * whether fd is long enough to be worth reading whole and
+ * cutting up; a stream, whose length isn't known, is
+ * parsed as it comes.
+ */
+static int
+big(int fd)
+{
+	int r;
+	Dir *d;
+
+	if((d = dirfstat(fd)) == nil)
+		return 0;
+	r = d->length >= 2*Minpart;
+	free(d);
+	return r;
+}
+
+static int
+parsepar(Xml *x, int fd, int flags)
+{
+	int rc;
+	long len;
+	uchar *buf;
+
+	buf = slurp(fd, &len);
+	rc = parserange(x, nil, buf, buf+len, 1, nil, 0, 0, flags);
+	free(buf);
+	return rc;
+}
+
+/*
+ * Flazy: the whole document is kept and the contents of
+ * the root's children are only noted, by defer.
+ */
+static int
+parselazy(Xml *x, int fd, int flags)
+{
+	long len;
+	State s;
+
+	x->src = slurp(fd, &len);
+	setupmem(&s, x, x->src, x->src+len, 1, flags);
+	bom(&s);
+	x->root = _xmlparse(&s, nil, 0);
+	free(s.bind);
+	return s.failed? -1: 0;
+}
+
+/*
+ * the first child of ep, parsing its contents first if
+ * they were put off by Flazy. This must be used rather
+ * than ep->child, or ep->pcdata, on a tree so made.
+ * If the contents don't parse the error is left in errstr,
+ * nil is returned and ep is left with no children or
+ * pcdata, now and on later calls.
+ */
+Elem *
+xmlchild(Elem *ep)
+{
+	Xlazy *lz;
+
+	if(ep == nil)
+		return nil;
+	if((lz = ep->lazy) != nil){
+		ep->lazy = nil;
+		if(parserange(lz->xml, ep, lz->start, lz->end, lz->line,
+		    lz->bind, lz->nbind, lz->base, lz->flags) == -1){
+			ep->child = nil;
+			ep->pcdata = nil;
+			werrstr("%s", lz->xml->err);
+			return nil;
+		}
+	}
+	return ep->child;
 }
 
 Xml *
 xmlparse(int fd, int blksize, int flags)
 {
-	State s;
-	Biobuf bio;
 	Xml *x;
 
-	memset(&s, 0, sizeof(s));
-	s.line = 1;
-	Binit(&bio, fd, OREAD);
-	s.bp = &bio;
-	s.flags = flags;
+	if((x = xmlnew(blksize)) == nil)
+		return nil;
+	if(xmlreparse(x, fd, flags) == -1){
+		xmlfree(x);
+		return nil;
+	}
+	return x;
+}
+
+/*
+ * parse fd into x, reusing the memory of any tree
+ * already there. On error x is left empty.
+ */
+int
+xmlreparse(Xml *x, int fd, int flags)
+{
+	int rc;
+	vlong t;
+	State s;
+
+	t = nsec();
+	xmlreset(x);
+	x->err[0] = 0;
+	if(flags & Flazy)
+		rc = parselazy(x, fd, flags);
+	else if((flags & Fparallel) && big(fd))
+		rc = parsepar(x, fd, flags);
+	else{
+		setup(&s, x, fd, flags);
+		x->root = _xmlparse(&s, nil, 0);
+		free(s.buf);
+		free(s.bind);
+		rc = s.failed? -1: 0;
+	}
+	if(rc == -1){
+		xmlreset(x);
+		werrstr("%s", x->err);
+	}else
+		x->stats.parsens = nsec() - t;
+	return rc;
+}
+
+/*
+ * Parse as xmlparse does but hand each element, attribute
+ * and pcdata to the callbacks in sax instead of building a
+ * tree, so memory use does not grow with the document.
+ */
+int
+xmlsax(int fd, Xsax *sax, int flags)
+{
+	int rc;
+	State s;
+	Xml *x;
 
-	x = xmlnew(blksize);
-	s.xml = x;
+	if((x = xmlnew(8192)) == nil)		/* DOCTYPE and errors only */
+		return -1;
+	setup(&s, x, fd, flags);
+	s.sax = sax;
 
-	x->root = _xmlparse(&s, nil, 0);
+	_xmlparse(&s, nil, 0);
+	free(s.buf);
+	free(s.bind);
+	rc = 0;
 	if(s.failed){
-		if(x)
-			xmlfree(x);
-		x = nil;
+		werrstr("%s", x->err);
+		rc = -1;
 	}
-	Bterm(&bio);
-	return x;
+	xmlfree(x);
+	return rc;
 }
@@ -0,0 +1,206 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Compiled paths: "/a/b[@attr]/c[@attr=value]" is split
+ * once into a sequence of atoms so that it can be run
+ * against any number of trees without touching the
+ * path string again. Names match exactly, as in
+ * xmlfind, and any step may carry a predicate. Values
+ * may be quoted with ' or " if they contain / or ].
+ */
+
+static char *
+name(char *p)
+{
+	while(*p && *p != '/' && *p != '[' && *p != ']' && *p != '=')
+		p++;
+	return p;
+}
+
+static int
+step(Xstep *sp, char **pp)
+{
+	char *p, *e;
+	int q;
+
+	p = *pp;
+	e = name(p);
+	if(e == p){
+		werrstr("empty name");
+		return -1;
+	}
+	sp->attr = 0;
+	sp->value = nil;
+	if(*e != '['){
+		if(*e != 0 && *e != '/'){
+			werrstr("unexpected '%c'", *e);
+			return -1;
+		}
+		if(*e)
+			*e++ = 0;
+		sp->atom = xmlatom(p);
+		*pp = e;
+		return 0;
+	}
+	*e++ = 0;
+	sp->atom = xmlatom(p);
+
+	if(*e++ != '@'){
+		werrstr("predicate must start with '@'");
+		return -1;
+	}
+	p = e;
+	e = name(p);
+	if(e == p){
+		werrstr("empty attribute name");
+		return -1;
+	}
+	if(*e == '='){
+		*e++ = 0;
+		if(*e == '\'' || *e == '"'){
+			q = *e++;
+			sp->value = e;
+			if((e = strchr(e, q)) == nil){
+				werrstr("unterminated quote");
+				return -1;
+			}
+			*e++ = 0;
+		}else{
+			sp->value = e;
+			if((e = strchr(e, ']')) == nil){
+				werrstr("missing ']'");
+				return -1;
+			}
+		}
+	}
+	if(*e != ']'){
+		werrstr("missing ']'");
+		return -1;
+	}
+	*e++ = 0;
+	sp->attr = xmlatom(p);
+
+	if(*e != 0 && *e != '/'){
+		werrstr("unexpected '%c'", *e);
+		return -1;
+	}
+	if(*e)
+		e++;
+	*pp = e;
+	return 0;
+}
+
+Xpath *
+xmlpath(char *path)
+{
+	int n;
+	char *p, *s;
+	Xpath *q;
+
+	if(path == nil){
+		werrstr("nil path");
+		return nil;
+	}
+	p = path;
+	if(*p == '/')
+		p++;
+
+	/* an upper bound, quoted values may contain '/' */
+	n = 1;
+	for(s = p; *s; s++)
+		if(*s == '/')
+			n++;
+
+	q = malloc(sizeof(Xpath) + n*sizeof(Xstep) + strlen(p)+1);
+	if(q == nil)
+		return nil;
+	q->step = (Xstep *)&q[1];
+	s = (char *)&q->step[n];
+	strcpy(s, p);
+
+	for(q->nstep = 0; *s; q->nstep++)
+		if(step(&q->step[q->nstep], &s) == -1){
+			werrstr("%s: %r", path);
+			free(q);
+			return nil;
+		}
+	if(q->nstep == 0){
+		werrstr("empty path");
+		free(q);
+		return nil;
+	}
+	return q;
+}
+
+void
+xmlpathfree(Xpath *q)
+{
+	free(q);
+}
+
+static int
+matches(Xstep *sp, Elem *ep)
+{
+	Attr *ap;
+
+	if(ep->atom != sp->atom)
+		return 0;
+	if(sp->attr == 0)
+		return 1;
+	for(ap = ep->attrs; ap; ap = ap->next)
+		if(ap->atom == sp->attr)
+			if(sp->value == nil || strcmp(ap->value, sp->value) == 0)
+				return 1;
+	return 0;
+}
+
+static Elem *
+search(Xstep *sp, Xstep *last, Elem *ep)
+{
+	Elem *t;
+
+	for(; ep; ep = ep->next)
+		if(matches(sp, ep)){
+			if(sp == last)
+				return ep;
+			if(xmlchild(ep))
+				if((t = search(sp+1, last, ep->child)) != nil)
+					return t;
+		}
+	return nil;
+}
+
+/*
+ * first match for q, starting at ep and its siblings.
+ */
+Elem *
+xmlquery(Xpath *q, Elem *ep)
+{
+	if(q == nil)
+		return nil;
+	return search(q->step, &q->step[q->nstep-1], ep);
+}
+
+/*
+ * next match after ep, which was returned by xmlquery
+ * or xmlnext for the same path; matches are returned
+ * in document order.
+ */
+Elem *
+xmlnext(Xpath *q, Elem *ep)
+{
+	Xstep *sp, *last;
+	Elem *t;
+
+	if(q == nil)
+		return nil;
+	last = &q->step[q->nstep-1];
+	for(sp = last; sp >= q->step && ep != nil; sp--){
+		if((t = search(sp, last, ep->next)) != nil)
+			return t;
+		ep = ep->parent;
+	}
+	return nil;
+}
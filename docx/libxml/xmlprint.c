@@ -1,83 +1,210 @@
 #include <u.h>
 #include <libc.h>
-#include <bio.h>
-#include <ctype.h>
 #include "xml.h"
 
+enum {
+	Nout = 64*1024,		/* output buffer */
+	Indent = 4,		/* per level, unless compact */
+};
+
+typedef struct {
+	int fd;
+	uchar *buf;
+	uchar *p;		/* next free byte */
+	uchar *e;		/* end of buf */
+} Out;
+
 static void
-prval(Biobuf *bp, char *s)
+flush(Out *o)
 {
-	char *p;
-	Rune r;
-
-	p = s;
-	while(*p){
-		p += chartorune(&r, p);
-		switch(r){
-		case L'&': Bprint(bp, "&amp;"); break;
-		case L'<': Bprint(bp, "&lt;"); break;
-		case L'>': Bprint(bp, "&gt;"); break;
-		case L'"': Bprint(bp, "&quot;"); break;
-		case L'\'': Bprint(bp, "&apos;"); break;
-		default: 
-			if(r >= L' ')
-				Bprint(bp, "%C", r);
-			else
-				Bprint(bp, "&#x%04x;", r);
+	if(o->p > o->buf)
+		write(o->fd, o->buf, o->p - o->buf);
+	o->p = o->buf;
+}
+
+static void
+put(Out *o, void *s, long n)
+{
+	if(o->p + n > o->e){
+		flush(o);
+		if(n > o->e - o->buf){
+			write(o->fd, s, n);
+			return;
+		}
+	}
+	memmove(o->p, s, n);
+	o->p += n;
+}
+
+static void
+putstr(Out *o, char *s)
+{
+	put(o, s, strlen(s));
+}
+
+static void
+indent(Out *o, int n)
+{
+	static char spaces[] = "                                ";
+
+	for(; n > sizeof(spaces)-1; n -= sizeof(spaces)-1)
+		put(o, spaces, sizeof(spaces)-1);
+	put(o, spaces, n);
+}
+
+/*
+ * text needing no escapes is found by _Xscanesc and
+ * copied a span at a time.
+ */
+static void
+prval(Out *o, char *s)
+{
+	int n;
+	uchar *p, *q, *e;
+	char buf[16];
+
+	p = (uchar *)s;
+	e = p + strlen(s);
+	for(;;){
+		q = _Xscanesc(p, e);
+		put(o, p, q - p);
+		if(q == e)
+			break;
+		switch(*q){
+		case '&': putstr(o, "&amp;"); break;
+		case '<': putstr(o, "&lt;"); break;
+		case '>': putstr(o, "&gt;"); break;
+		case '"': putstr(o, "&quot;"); break;
+		case '\'': putstr(o, "&apos;"); break;
+		default:
+			n = snprint(buf, sizeof(buf), "&#x%04x;", *q);
+			put(o, buf, n);
 			break;
 		}
+		p = q+1;
 	}
 }
 
 static void
-_xmlprint(Biobuf *bp, Elem *ep, int in)
+_xmlprint(Out *o, Elem *ep, int in)
 {
 	Attr *ap;
-	enum {indent = 4};
 
 	for(; ep; ep = ep->next){
-		Bprint(bp, "%*s<%s", in, "", ep->name);
-	
+		indent(o, in);
+		putstr(o, "<");
+		putstr(o, ep->name);
+
 		for (ap = ep->attrs; ap; ap = ap->next){
-			Bprint(bp, " %s=\'", ap->name);
-			prval(bp, ap->value);
-			Bprint(bp, "\'");
+			putstr(o, " ");
+			putstr(o, ap->name);
+			putstr(o, "='");
+			prval(o, ap->value);
+			putstr(o, "'");
 		}
 
-		if(ep->child){
+		if(xmlchild(ep)){
 			if(ep->pcdata){
-				Bprint(bp, ">\n%*s\n", in+indent, "");
-				prval(bp, ep->pcdata);
+				putstr(o, ">\n");
+				indent(o, in+Indent);
+				putstr(o, "\n");
+				prval(o, ep->pcdata);
 			}
 			else
-				Bprint(bp, ">\n");
-			_xmlprint(bp, ep->child, in+indent);
-			Bprint(bp, "%*s</%s>\n", in, "", ep->name);
+				putstr(o, ">\n");
+			_xmlprint(o, ep->child, in+Indent);
+			indent(o, in);
+			putstr(o, "</");
+			putstr(o, ep->name);
+			putstr(o, ">\n");
 		}
 		else{
 			if(ep->pcdata){
-				Bprint(bp, ">\n%*s", in+indent, "");
-				prval(bp, ep->pcdata);
-				Bprint(bp, "\n%*s</%s>\n", in, "", ep->name);
+				putstr(o, ">\n");
+				indent(o, in+Indent);
+				prval(o, ep->pcdata);
+				putstr(o, "\n");
+				indent(o, in);
+				putstr(o, "</");
+				putstr(o, ep->name);
+				putstr(o, ">\n");
 			}
 			else
-				Bprint(bp, "/>\n");
+				putstr(o, "/>\n");
 		}
 	}
 }
 
-void
-xmlprint(Xml *xp, int fd)
+/*
+ * no indentation or newlines, an element's pcdata comes
+ * straight after its start tag so parsing the output
+ * gives back the same tree.
+ */
+static void
+_xmlprintc(Out *o, Elem *ep)
+{
+	Attr *ap;
+
+	for(; ep; ep = ep->next){
+		putstr(o, "<");
+		putstr(o, ep->name);
+		for (ap = ep->attrs; ap; ap = ap->next){
+			putstr(o, " ");
+			putstr(o, ap->name);
+			putstr(o, "='");
+			prval(o, ap->value);
+			putstr(o, "'");
+		}
+		if(xmlchild(ep) == nil && ep->pcdata == nil){
+			putstr(o, "/>");
+			continue;
+		}
+		putstr(o, ">");
+		if(ep->pcdata)
+			prval(o, ep->pcdata);
+		_xmlprintc(o, ep->child);
+		putstr(o, "</");
+		putstr(o, ep->name);
+		putstr(o, ">");
+	}
+}
+
+static void
+emit(Xml *xp, int fd, int compact)
 {
-	Biobuf bout;
+	Out o;
+
+	if((o.buf = malloc(Nout)) == nil)
+		sysfatal("xmlprint: no memory\n");
+	o.fd = fd;
+	o.p = o.buf;
+	o.e = o.buf + Nout;
 
-	Binit(&bout, fd, OWRITE);
 	if(xp->doctype){
-		Bprint(&bout, "<?xml version='1.0' encoding='utf-8'?>\n");
-		Bprint(&bout, "<!DOCTYPE %s>\n", xp->doctype);
+		putstr(&o, "<?xml version='1.0' encoding='utf-8'?>\n");
+		putstr(&o, "<!DOCTYPE ");
+		putstr(&o, xp->doctype);
+		putstr(&o, ">\n");
 	}
 	else
-		Bprint(&bout, "<?xml version='1.0' encoding='utf-8' standalone='yes'?>\n");
-	_xmlprint(&bout, xp->root, 0);
-	Bterm(&bout);
+		putstr(&o, "<?xml version='1.0' encoding='utf-8' standalone='yes'?>\n");
+	if(compact){
+		_xmlprintc(&o, xp->root);
+		putstr(&o, "\n");
+	}else
+		_xmlprint(&o, xp->root, 0);
+	flush(&o);
+	free(o.buf);
+}
+
+void
+xmlprint(Xml *xp, int fd)
+{
+	emit(xp, fd, 0);
+}
+
+void
+xmlprintc(Xml *xp, int fd)
+{
+	emit(xp, fd, 1);
 }
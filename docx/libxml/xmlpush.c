@@ -0,0 +1,149 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Push parsing: the caller hands over the document in pieces
+ * of any size as it gets them. Rather than turn the parser
+ * inside out, an ordinary parse runs in its own proc reading
+ * from a pipe that xmlpush writes into; the pipe carries
+ * half a UTF-8 sequence, entity or CDATA terminator between
+ * pieces like any other bytes, and the parse overlaps the
+ * caller's work producing the next piece.
+ */
+
+struct Xpush {
+	int	fd;			/* our end of the pipe */
+	int	sync;			/* at end of file once the parser is gone */
+	int	flags;
+	int	rc;			/* from xmlreparse */
+	int	done;			/* the parser got as far as setting rc */
+	int	dead;			/* a write found the pipe closed */
+	Xml	*xml;
+};
+
+static void
+parser(Xpush *p, int fd)
+{
+	char buf[1024];
+
+	p->rc = xmlreparse(p->xml, fd, p->flags);
+	p->done = 1;
+
+	/* the writer must never find the pipe closed */
+	while(read(fd, buf, sizeof(buf)) > 0)
+		;
+	close(fd);
+}
+
+static int
+closedpipe(void*, char *msg)
+{
+	return strstr(msg, "write on closed pipe") != nil;
+}
+
+/*
+ * The parser runs with RFNOWAIT and is never waited for:
+ * waitpid could reap a child of our caller's. Instead it
+ * holds the write end of a second pipe, which nothing is
+ * written to and which is closed when it exits, however
+ * it goes.
+ */
+Xpush *
+xmlpushnew(int blksize, int flags)
+{
+	int pfd[2], sfd[2];
+	Xpush *p;
+
+	if((p = mallocz(sizeof(Xpush), 1)) == nil)
+		return nil;
+	if((p->xml = xmlnew(blksize)) == nil){
+		free(p);
+		return nil;
+	}
+	if(pipe(pfd) == -1){
+		xmlfree(p->xml);
+		free(p);
+		return nil;
+	}
+	if(pipe(sfd) == -1){
+		close(pfd[0]);
+		close(pfd[1]);
+		xmlfree(p->xml);
+		free(p);
+		return nil;
+	}
+	p->flags = flags;
+	p->fd = pfd[0];
+	p->sync = sfd[0];
+
+	switch(rfork(RFPROC|RFMEM|RFFDG|RFNOWAIT)){
+	case -1:
+		close(pfd[0]);
+		close(pfd[1]);
+		close(sfd[0]);
+		close(sfd[1]);
+		xmlfree(p->xml);
+		free(p);
+		return nil;
+	case 0:
+		close(pfd[0]);
+		close(sfd[0]);
+		parser(p, pfd[1]);
+		_exits(nil);
+	}
+	close(pfd[1]);
+	close(sfd[1]);
+	return p;
+}
+
+/*
+ * feed the next n bytes of the document to the parser.
+ * -1 if it is gone, in which case xmlpushdone says why.
+ */
+int
+xmlpush(Xpush *p, void *buf, long n)
+{
+	long w;
+
+	if(n <= 0)
+		return 0;
+	if(p->dead)
+		return -1;
+	atnotify(closedpipe, 1);
+	w = write(p->fd, buf, n);
+	atnotify(closedpipe, 0);
+	if(w != n){
+		p->dead = 1;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * end of document: wait for the parse to finish and return
+ * the tree, or nil with the parser's error in errstr.
+ * p is freed in either case.
+ */
+Xml *
+xmlpushdone(Xpush *p)
+{
+	char c;
+	Xml *x;
+
+	close(p->fd);
+	while(read(p->sync, &c, 1) > 0)
+		;
+	close(p->sync);
+	x = p->xml;
+	if(!p->done || p->rc == -1){
+		if(!p->done)
+			werrstr("xmlpush: parser died");
+		else
+			werrstr("%s", x->err);
+		xmlfree(x);
+		x = nil;
+	}
+	free(p);
+	return x;
+}
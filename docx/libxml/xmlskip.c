@@ -0,0 +1,23 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * have xmlreparse keep elements called name, with their
+ * attributes, but pass over their contents unread so no
+ * time or memory is spent on parts of a document that
+ * will be ignored, like the pictures in a word document.
+ */
+void
+xmlskip(Xml *xp, char *name)
+{
+	int i, atom;
+
+	atom = xmlatom(name);
+	for(i = 0; i < xp->nskip; i++)
+		if(xp->skip[i] == atom)
+			return;
+	if((xp->skip = realloc(xp->skip, (xp->nskip+1) * sizeof(int))) == nil)
+		sysfatal("xmlskip: no memory\n");
+	xp->skip[xp->nskip++] = atom;
+}
@@ -0,0 +1,833 @@
+#include <u.h>
+#include <libc.h>
+#include "xml.h"
+
+/*
+ * Regression tests, see mk test. A file is parsed every
+ * way the library offers and what came out is printed, to
+ * be compared with a run known to be good. Trees that must
+ * be the same as the plain parse's are only printed in full
+ * if they are not.
+ *
+ *	xmltest file		all the ways of parsing file
+ *	xmltest -s file		snapshots of file, some damaged
+ *	xmltest -p		a document big enough to be split,
+ *				and one too big for its arena
+ */
+
+enum {
+	Hdrlen = 8 + 6*4,	/* of a snapshot */
+	Elemlen = 7*4,
+	Npush = 5,		/* bytes given to xmlpush at a time */
+	Nrows = 40000,		/* in the document made by -p */
+};
+
+typedef struct Buf Buf;
+struct Buf {
+	char	*s;
+	long	n;
+	long	max;
+};
+
+static char *tmp;
+
+static void
+bput(Buf *b, char *s, long n)
+{
+	if(b->n + n + 1 > b->max){
+		b->max = (b->n + n + 1) * 2;
+		if((b->s = realloc(b->s, b->max)) == nil)
+			sysfatal("no memory");
+	}
+	memmove(b->s + b->n, s, n);
+	b->n += n;
+	b->s[b->n] = 0;
+}
+
+static void
+bprint(Buf *b, char *fmt, ...)
+{
+	va_list arg;
+	char *s;
+
+	va_start(arg, fmt);
+	s = vsmprint(fmt, arg);
+	va_end(arg);
+	if(s == nil)
+		sysfatal("no memory");
+	bput(b, s, strlen(s));
+	free(s);
+}
+
+static char *
+bstr(Buf *b)
+{
+	return b->s? b->s: "";
+}
+
+static void
+bfree(Buf *b)
+{
+	free(b->s);
+	memset(b, 0, sizeof(Buf));
+}
+
+static void
+quote(Buf *b, char *s)
+{
+	char *p;
+
+	if(s == nil){
+		bprint(b, "nil");
+		return;
+	}
+	bput(b, "\"", 1);
+	for(p = s; *p; p++){
+		if((uchar)*p >= ' ' && *p != '"' && *p != '\\')
+			continue;
+		bput(b, s, p-s);
+		s = p+1;
+		switch(*p){
+		case '\n':
+			bprint(b, "\\n");
+			break;
+		case '\t':
+			bprint(b, "\\t");
+			break;
+		case '"':
+		case '\\':
+			bprint(b, "\\%c", *p);
+			break;
+		default:
+			bprint(b, "\\x%02x", (uchar)*p);
+			break;
+		}
+	}
+	bput(b, s, p-s);
+	bput(b, "\"", 1);
+}
+
+static void
+name(Buf *b, char *s, int ns)
+{
+	bprint(b, "%s", s);
+	if(ns)
+		bprint(b, "{%s}", xmlatomname(ns));
+}
+
+static void
+dumpelem(Buf *b, Elem *ep, int depth)
+{
+	Attr *ap;
+	Elem *cp;
+
+	for(; ep; ep = ep->next){
+		cp = xmlchild(ep);
+		bprint(b, "%*s<", depth*2, "");
+		name(b, ep->name, ep->ns);
+		bprint(b, " line=%d", ep->line);
+		for(ap = ep->attrs; ap; ap = ap->next){
+			bprint(b, " ");
+			name(b, ap->name, ap->ns);
+			bprint(b, "=");
+			quote(b, ap->value);
+		}
+		bprint(b, ">\n");
+		if(ep->pcdata){
+			bprint(b, "%*s", depth*2+2, "");
+			quote(b, ep->pcdata);
+			bprint(b, "\n");
+		}
+		dumpelem(b, cp, depth+1);
+	}
+}
+
+/*
+ * the tree is walked before the doctype is printed: with
+ * Flazy one in an element's contents is only found when
+ * xmlchild parses them.
+ */
+static void
+dump(Buf *b, Xml *xp)
+{
+	char err[ERRMAX];
+	Buf t;
+
+	if(xp == nil){
+		bprint(b, "error: %r\n");
+		return;
+	}
+	memset(&t, 0, sizeof(Buf));
+	werrstr("");
+	dumpelem(&t, xp->root, 0);
+	rerrstr(err, sizeof(err));
+	if(xp->doctype){
+		bprint(b, "doctype ");
+		quote(b, xp->doctype);
+		bprint(b, "\n");
+	}
+	bprint(b, "%s", bstr(&t));
+	bfree(&t);
+	if(err[0])
+		bprint(b, "error: %s\n", err);
+}
+
+static void
+dumpflat(Buf *b, Xflat *f, int n, int depth)
+{
+	Xnode *np;
+	Xattr *ap, *ea;
+
+	for(; n; n = f->node[n].next){
+		np = &f->node[n];
+		bprint(b, "%*s<", depth*2, "");
+		name(b, xmlatomname(np->atom), np->ns);
+		bprint(b, " line=%d", np->line);
+		ea = &f->attr[f->node[n+1].attr];
+		for(ap = &f->attr[np->attr]; ap < ea; ap++){
+			bprint(b, " ");
+			name(b, xmlatomname(ap->atom), ap->ns);
+			bprint(b, "=");
+			quote(b, ap->value < 0? nil: f->text + ap->value);
+		}
+		bprint(b, ">\n");
+		if(xmlflattext(f, n)){
+			bprint(b, "%*s", depth*2+2, "");
+			quote(b, xmlflattext(f, n));
+			bprint(b, "\n");
+		}
+		dumpflat(b, f, np->child, depth+1);
+	}
+}
+
+static void
+freexml(Xml *xp)
+{
+	if(xp)
+		xmlfree(xp);
+}
+
+static Xml *
+parse(char *file, char *skip, int flags)
+{
+	int fd;
+	Xml *xp;
+
+	if((fd = open(file, OREAD)) == -1)
+		sysfatal("%s: %r", file);
+	if((xp = xmlnew(8192)) == nil)
+		sysfatal("no memory");
+	if(skip)
+		xmlskip(xp, skip);
+	if(xmlreparse(xp, fd, flags) == -1){
+		freexml(xp);
+		xp = nil;
+	}
+	close(fd);
+	return xp;
+}
+
+/*
+ * print b if it differs from want
+ */
+static void
+same(char *what, Buf *b, Buf *want)
+{
+	if(strcmp(bstr(b), bstr(want)) == 0)
+		print("== %s: same\n", what);
+	else
+		print("== %s\n%s", what, bstr(b));
+	bfree(b);
+}
+
+/*
+ * short attribute values not the copy xmlintern hands
+ * out, which under Fintern there should be none of
+ */
+static int
+unshared(Elem *ep)
+{
+	int n;
+	Attr *ap;
+
+	for(n = 0; ep; ep = ep->next){
+		for(ap = ep->attrs; ap; ap = ap->next)
+			if(ap->value && strlen(ap->value) <= 16 && ap->value != xmlintern(ap->value))
+				n++;
+		n += unshared(ep->child);
+	}
+	return n;
+}
+
+static void
+evstart(Xsax *sax, char *name, int, int line)
+{
+	bprint(sax->aux, "start %s line=%d\n", name, line);
+}
+
+static void
+evattr(Xsax *sax, char *name, int, char *value)
+{
+	bprint(sax->aux, "attr %s=", name);
+	quote(sax->aux, value);
+	bprint(sax->aux, "\n");
+}
+
+static void
+evtext(Xsax *sax, char *text)
+{
+	bprint(sax->aux, "text ");
+	quote(sax->aux, text);
+	bprint(sax->aux, "\n");
+}
+
+static void
+evend(Xsax *sax, char *name)
+{
+	bprint(sax->aux, "end %s\n", name);
+}
+
+static uchar *
+slurp(char *file, long *np)
+{
+	int fd;
+	long n, m;
+	uchar *buf;
+
+	if((fd = open(file, OREAD)) == -1)
+		sysfatal("%s: %r", file);
+	n = 0;
+	buf = nil;
+	do{
+		if((buf = realloc(buf, n+8192)) == nil)
+			sysfatal("no memory");
+		m = read(fd, buf+n, 8192);
+		if(m > 0)
+			n += m;
+	}while(m > 0);
+	close(fd);
+	*np = n;
+	return buf;
+}
+
+static void
+spit(char *file, void *buf, long n)
+{
+	int fd;
+
+	if((fd = create(file, OWRITE, 0600)) == -1)
+		sysfatal("%s: %r", file);
+	if(write(fd, buf, n) != n)
+		sysfatal("%s: %r", file);
+	close(fd);
+}
+
+static void
+all(char *file)
+{
+	int fd, i;
+	long n;
+	uchar *buf;
+	Buf want, b;
+	Xml *xp;
+	Xpush *p;
+	Xsax sax;
+	Xflat *f;
+
+	memset(&want, 0, sizeof(Buf));
+	memset(&b, 0, sizeof(Buf));
+
+	dump(&want, xp = parse(file, nil, 0));
+	print("== plain\n%s", bstr(&want));
+	freexml(xp);
+
+	dump(&b, xp = parse(file, nil, Fcrushwhite));
+	print("== crushwhite\n%s", bstr(&b));
+	bfree(&b);
+	freexml(xp);
+
+	dump(&b, xp = parse(file, nil, Fstripnamespace));
+	print("== stripnamespace\n%s", bstr(&b));
+	bfree(&b);
+	freexml(xp);
+
+	dump(&b, xp = parse(file, nil, Flazy));
+	same("lazy", &b, &want);
+	freexml(xp);
+
+	dump(&b, xp = parse(file, nil, Fparallel));
+	same("parallel", &b, &want);
+	freexml(xp);
+
+	dump(&b, xp = parse(file, "skip", 0));
+	same("skip", &b, &want);
+	freexml(xp);
+
+	dump(&b, xp = parse(file, nil, Fintern|Fparallel));
+	same("intern", &b, &want);
+	if(xp && (i = unshared(xp->root)) != 0)
+		print("%d values not shared\n", i);
+	freexml(xp);
+
+	buf = slurp(file, &n);
+	if((p = xmlpushnew(8192, 0)) == nil)
+		sysfatal("xmlpushnew: %r");
+	for(i = 0; i < n; i += Npush)
+		if(xmlpush(p, buf+i, n-i < Npush? n-i: Npush) == -1)
+			break;
+	dump(&b, xp = xmlpushdone(p));
+	same("push", &b, &want);
+	freexml(xp);
+	free(buf);
+
+	memset(&sax, 0, sizeof(sax));
+	sax.aux = &b;
+	sax.start = evstart;
+	sax.attr = evattr;
+	sax.text = evtext;
+	sax.end = evend;
+	if((fd = open(file, OREAD)) == -1)
+		sysfatal("%s: %r", file);
+	if(xmlsax(fd, &sax, 0) == -1)
+		bprint(&b, "error: %r\n");
+	close(fd);
+	print("== sax\n%s", bstr(&b));
+	bfree(&b);
+
+	if((xp = parse(file, nil, 0)) != nil){
+		if((f = xmlflatten(xp)) == nil)
+			sysfatal("xmlflatten: %r");
+		if(xp->doctype){
+			bprint(&b, "doctype ");
+			quote(&b, xp->doctype);
+			bprint(&b, "\n");
+		}
+		dumpflat(&b, f, f->node[0].child, 0);
+		same("flat", &b, &want);
+		xmlflatfree(f);
+
+		if((fd = create(tmp, OWRITE, 0600)) == -1)
+			sysfatal("%s: %r", tmp);
+		if(xmlsnapshot(xp, fd) == -1)
+			sysfatal("xmlsnapshot: %r");
+		close(fd);
+		freexml(xp);
+		if((fd = open(tmp, OREAD)) == -1)
+			sysfatal("%s: %r", tmp);
+		dump(&b, xp = xmlsnapload(fd, 8192));
+		close(fd);
+		same("snapshot", &b, &want);
+		remove(tmp);
+	}
+	freexml(xp);
+	bfree(&want);
+}
+
+static ulong
+get32(uchar *p)
+{
+	return p[0] | p[1]<<8 | p[2]<<16 | (ulong)p[3]<<24;
+}
+
+static void
+put32(uchar *p, ulong v)
+{
+	p[0] = v;
+	p[1] = v>>8;
+	p[2] = v>>16;
+	p[3] = v>>24;
+}
+
+/*
+ * load buf, n bytes of snapshot, and say what happened
+ */
+static void
+load(char *what, uchar *buf, long n, Buf *want)
+{
+	int fd;
+	Buf b;
+	Xml *xp;
+
+	spit(tmp, buf, n);
+	if((fd = open(tmp, OREAD)) == -1)
+		sysfatal("%s: %r", tmp);
+	xp = xmlsnapload(fd, 8192);
+	close(fd);
+	remove(tmp);
+	if(xp == nil){
+		print("%s: error: %r\n", what);
+		return;
+	}
+	memset(&b, 0, sizeof(Buf));
+	dump(&b, xp);
+	print("%s: %s\n", what, strcmp(bstr(&b), bstr(want)) == 0? "same": "loaded, but different");
+	bfree(&b);
+	freexml(xp);
+}
+
+static void
+snaps(char *file)
+{
+	int fd, i, j;
+	long n, elems, attrs;
+	uchar *buf, *big;
+	char what[64];
+	Buf want;
+	Xml *xp;
+	static long cut[] = { 0, 8, Hdrlen-1, Hdrlen, Hdrlen+4 };
+	static struct {
+		char	*name;
+		int	off;
+	} field[] = {
+		"nelem", 8,
+		"nattr", 12,
+		"nname", 16,
+		"ntext", 20,
+		"doctype", 24,
+	};
+	static ulong bad[] = { 0x7fffffff, 0xffffffff, 0x0924924a, 0x10000000 };
+
+	if((xp = parse(file, nil, 0)) == nil)
+		sysfatal("%s: %r", file);
+	memset(&want, 0, sizeof(Buf));
+	dump(&want, xp);
+	if((fd = create(tmp, OWRITE, 0600)) == -1)
+		sysfatal("%s: %r", tmp);
+	if(xmlsnapshot(xp, fd) == -1)
+		sysfatal("xmlsnapshot: %r");
+	close(fd);
+	freexml(xp);
+	buf = slurp(tmp, &n);
+
+	load("whole", buf, n, &want);
+	for(i = 0; i < nelem(cut); i++){
+		snprint(what, sizeof(what), "cut to %ld", cut[i]);
+		load(what, buf, cut[i], &want);
+	}
+	load("cut in half", buf, n/2, &want);
+	load("last byte cut", buf, n-1, &want);
+
+	/* counts too big for the file, or for the arithmetic */
+	if((big = malloc(n + 200*1024)) == nil)
+		sysfatal("no memory");
+	memset(big+n, 'x', 200*1024);
+	for(i = 0; i < nelem(field); i++)
+		for(j = 0; j < nelem(bad); j++){
+			memmove(big, buf, n);
+			put32(big+field[i].off, bad[j]);
+			snprint(what, sizeof(what), "%s=%#lux", field[i].name, bad[j]);
+			load(what, big, n, &want);
+			snprint(what, sizeof(what), "%s=%#lux padded", field[i].name, bad[j]);
+			load(what, big, n + 200*1024, &want);
+		}
+	free(big);
+
+	/* names must be there, only a namespace may be none */
+	elems = Hdrlen + get32(buf+16)*4;
+	attrs = elems + get32(buf+8)*Elemlen;
+	j = get32(buf+elems+8);
+	put32(buf+elems+8, 0);
+	load("element name 0", buf, n, &want);
+	put32(buf+elems+8, j);
+	put32(buf+attrs, 0);
+	load("attribute name 0", buf, n, &want);
+
+	free(buf);
+	bfree(&want);
+}
+
+static void
+row(Buf *b, int i)
+{
+	bprint(b, "<w:row r=\"%d\" w:x=\"a%d\">\n\t<c s=\"%d\">text &amp; %d</c>%s", i, i%7, i%13, i, i%3? "": " tail ");
+	if(i%5 == 0)
+		bprint(b, "<skip><x><![CDATA[</skip>]]></x></skip>");
+	bprint(b, "<e/></w:row>\n");
+}
+
+/*
+ * patterns matched against the -p document, by walking
+ * its tree and its event stream; the counts go to arg
+ */
+static char *Patterns[] = { "/doc/w:row/c", "x", "w:row/e" };
+static int Pattern[] = { 0, 1, 2 };
+
+static void
+count(Elem *, void *aux, void *arg)
+{
+	((int *)arg)[*(int *)aux]++;
+}
+
+static void
+match(char *file)
+{
+	int i, fd, tree[nelem(Patterns)], events[nelem(Patterns)];
+	Xmatch *m;
+	Xml *xp;
+
+	if((m = xmlmatchnew()) == nil)
+		sysfatal("no memory");
+	for(i = 0; i < nelem(Patterns); i++)
+		if(xmlmatchadd(m, Patterns[i], count, &Pattern[i]) == -1)
+			sysfatal("xmlmatchadd: %r");
+	memset(tree, 0, sizeof(tree));
+	memset(events, 0, sizeof(events));
+	if((xp = parse(file, nil, 0)) != nil)
+		xmlmatch(m, xp->root, tree);
+	freexml(xp);
+	if((fd = open(file, OREAD)) == -1)
+		sysfatal("%s: %r", file);
+	if(xmlmatchfd(m, fd, 0, events) == -1)
+		print("xmlmatchfd: %r\n");
+	close(fd);
+	print("== match\n");
+	for(i = 0; i < nelem(Patterns); i++)
+		print("%s tree=%d events=%d\n", Patterns[i], tree[i], events[i]);
+	xmlmatchfree(m);
+}
+
+static int
+reparse(Xml *xp, char *file, int flags)
+{
+	int fd, rc;
+
+	if((fd = open(file, OREAD)) == -1)
+		sysfatal("%s: %r", file);
+	rc = xmlreparse(xp, fd, flags);
+	close(fd);
+	return rc;
+}
+
+/*
+ * the -p document's numbers, r and s decoded by the
+ * parser, w:x, a cell from a1 to a6 or not one, on the
+ * fly
+ */
+static void
+nums(char *file, int flags)
+{
+	int i, n, bad, col, row;
+	Elem *ep, *cp;
+	Xml *xp;
+
+	if((xp = xmlnew(8192)) == nil)
+		sysfatal("no memory");
+	xmlnumeric(xp, "r");
+	xmlnumeric(xp, "s");
+	if(reparse(xp, file, flags) == -1)
+		sysfatal("%s: %r", file);
+	n = bad = 0;
+	for(ep = xp->root->child; ep; ep = ep->next){
+		i = n++;
+		if(xmlnum(ep, "r", -1) != i)
+			bad++;
+		if(xmlcell(ep, "w:x", &col, &row) == 0){
+			if(i%7 == 0 || col != 1 || row != i%7)
+				bad++;
+		}else if(i%7 != 0)
+			bad++;
+		for(cp = ep->child; cp; cp = cp->next)
+			if(cp->atom == xmlatom("c") && xmlnum(cp, "s", -1) != i%13)
+				bad++;
+	}
+	print("nums%s: %d rows, %d wrong\n", flags & Fparallel? " parallel": "", n, bad);
+	xmlfree(xp);
+}
+
+/*
+ * a document of Nrows rows with odd, if not nil, in
+ * place of one near the end: a split parse must give what
+ * a serial one does, even when the pieces can't be parsed
+ * on their own.
+ */
+static void
+big(char *what, char *odd)
+{
+	int i;
+	Buf doc, want, b;
+	Xstats s0, s1;
+	Xml *xp;
+
+	memset(&doc, 0, sizeof(Buf));
+	memset(&want, 0, sizeof(Buf));
+	memset(&b, 0, sizeof(Buf));
+	bprint(&doc, "<?xml version=\"1.0\"?>\n<doc xmlns=\"urn:d\" xmlns:w=\"urn:w\">\n");
+	for(i = 0; i < Nrows; i++)
+		if(odd && i == Nrows-Nrows/8)
+			bprint(&doc, "%s\n", odd);
+		else
+			row(&doc, i);
+	bprint(&doc, "</doc>\n");
+	spit(tmp, doc.s, doc.n);
+	bfree(&doc);
+
+	print("== %s\n", what);
+	xp = parse(tmp, nil, 0);
+	dump(&want, xp);
+	if(xp == nil)
+		print("%s", bstr(&want));
+	else{
+		xmlstats(xp, &s0);
+		print("elems=%d attrs=%d texts=%d maxdepth=%d\n", s0.elems, s0.attrs, s0.texts, s0.maxdepth);
+	}
+	freexml(xp);
+
+	dump(&b, xp = parse(tmp, nil, Fparallel));
+	same("parallel", &b, &want);
+	if(xp){
+		xmlstats(xp, &s1);
+		if(s1.elems != s0.elems || s1.attrs != s0.attrs || s1.texts != s0.texts || s1.maxdepth != s0.maxdepth)
+			print("parallel stats differ\n");
+		if(s1.requested != s0.requested)
+			print("parallel requested %lld, not %lld\n", s1.requested, s0.requested);
+	}
+	freexml(xp);
+
+	dump(&b, xp = parse(tmp, nil, Flazy|Fparallel));
+	same("lazy parallel", &b, &want);
+	freexml(xp);
+
+	bfree(&want);
+	dump(&want, xp = parse(tmp, "skip", 0));
+	freexml(xp);
+	dump(&b, xp = parse(tmp, "skip", Fparallel));
+	same("skip parallel", &b, &want);
+	freexml(xp);
+
+	if(odd == nil){
+		match(tmp);
+		nums(tmp, 0);
+		nums(tmp, Fparallel);
+	}
+	remove(tmp);
+	bfree(&want);
+}
+
+/*
+ * a document too big for the segment its Xml's arena
+ * comes from must fail cleanly, and leave the Xml fit
+ * to parse one that does fit.
+ */
+static void
+full(void)
+{
+	int i;
+	char err[ERRMAX];
+	Buf doc, b;
+	Xalloc *a;
+	Xml *xp;
+
+	print("== segment full\n");
+	if((a = xmlsegalloc(nil, 256*1024)) == nil)
+		sysfatal("xmlsegalloc: %r");
+	if((xp = xmlnewalloc(8192, a)) == nil)
+		sysfatal("no memory");
+	memset(&doc, 0, sizeof(Buf));
+	memset(&b, 0, sizeof(Buf));
+	bprint(&doc, "<doc>\n");
+	for(i = 0; i < Nrows/4; i++)
+		row(&doc, i);
+	bprint(&doc, "</doc>\n");
+	spit(tmp, doc.s, doc.n);
+	bfree(&doc);
+	/* where it runs out depends on the size of an Elem */
+	for(i = 0; i < 2; i++){
+		print("%s: ", i? "parallel": "serial");
+		if(reparse(xp, tmp, i? Fparallel: 0) == 0)
+			print("parsed\n");
+		else{
+			rerrstr(err, sizeof(err));
+			print("%s\n", strstr(err, "out of memory")? "out of memory": err);
+		}
+	}
+
+	bprint(&doc, "<a x=\"1\"><b/>text</a>\n");
+	spit(tmp, doc.s, doc.n);
+	bfree(&doc);
+	if(reparse(xp, tmp, 0) == -1)
+		print("then: error: %r\n");
+	else{
+		dump(&b, xp);
+		print("then:\n%s", bstr(&b));
+		bfree(&b);
+	}
+	remove(tmp);
+	xmlfree(xp);
+	xmlsegfree(a);
+}
+
+/*
+ * once the last block is given back the segment's pages
+ * go back to the kernel, so they read as zero when cut
+ * again
+ */
+static void
+release(void)
+{
+	int i, n;
+	uchar *p, *q;
+	Xalloc *a;
+
+	print("== segment release\n");
+	if((a = xmlsegalloc(nil, 64*1024)) == nil)
+		sysfatal("xmlsegalloc: %r");
+	p = a->alloc(a, 8192);
+	q = a->alloc(a, 8192);
+	if(p == nil || q == nil)
+		sysfatal("segalloc: %r");
+	memset(p, 0xAA, 8192);
+	memset(q, 0xAA, 8192);
+	a->free(a, p, 8192);
+	a->free(a, q, 8192);
+	if((p = a->alloc(a, 16384)) == nil)
+		sysfatal("segalloc: %r");
+	for(i = n = 0; i < 16384; i++)
+		if(p[i] != 0)
+			n++;
+	if(n)
+		print("%d bytes kept\n", n);
+	else
+		print("released\n");
+	a->free(a, p, 16384);
+	xmlsegfree(a);
+}
+
+static void
+usage(void)
+{
+	fprint(2, "usage: %s [-s] file | -p\n", argv0);
+	exits("usage");
+}
+
+void
+main(int argc, char *argv[])
+{
+	int sflag, pflag;
+
+	sflag = pflag = 0;
+	ARGBEGIN{
+	case 's':
+		sflag = 1;
+		break;
+	case 'p':
+		pflag = 1;
+		break;
+	default:
+		usage();
+	}ARGEND
+	if(pflag ? argc != 0 : argc != 1)
+		usage();
+
+	tmp = smprint("/tmp/xmltest.%d", getpid());
+	if(pflag){
+		big("good", nil);
+		big("nesting error", "<w:row><c></w:row>");
+		big("doctype inside", "<w:row><!DOCTYPE late></w:row>");
+		full();
+		release();
+	}else if(sflag)
+		snaps(argv[0]);
+	else
+		all(argv[0]);
+	exits(nil);
+}
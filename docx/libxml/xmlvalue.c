@@ -3,7 +3,7 @@
 #include "xml.h"
 
 char *
-xmlvalue(Elem *ep, char *name)
+xmlatomvalue(Elem *ep, int atom)
 {
 	Attr *ap;
 
@@ -13,7 +13,15 @@ xmlvalue(Elem *ep, char *name)
 	if (ep == nil)
 		return nil;
 	for(ap = ep->attrs; ap; ap = ap->next)
-		if(strcmp(ap->name, name) == 0)
+		if(ap->atom == atom)
 			return ap->value;
 	return nil;
 }
+
+char *
+xmlvalue(Elem *ep, char *name)
+{
+	if (ep == nil)
+		return nil;
+	return xmlatomvalue(ep, _Xatomn(name, strlen(name)));
+}
@@ -2,7 +2,6 @@
 #include <libc.h>
 #include <bio.h>
 #include <xml.h>
-#include <ctype.h>
 #include "xlsx.h"
 
 enum { Widefield = 40 };		/* wrap fields longer than this in tbl mode */
@@ -10,8 +9,61 @@ enum { Widefield = 40 };		/* wrap fields longer than this in tbl mode */
 char *Currency = "£";			/* currency symbol */
 int Epoch1904 = 1;				/* disable "as broken as Lotus-123" mode (yes really) */
 
+static char *Names[Natom] = {
+	[Sc]		"c",
+	[ScellXfs]	"cellXfs",
+	[Scol]		"col",
+	[Sis]		"is",
+	[SnumFmt]	"numFmt",
+	[SnumFmts]	"numFmts",
+	[Sr]		"r",
+	[Srow]		"row",
+	[Ssi]		"si",
+	[St]		"t",
+	[Sv]		"v",
+	[Sxf]		"xf",
+};
+
+int Atom[Natom];
+
 static char *Strtype[] = { "numeric", "inline", "shared", "boolean", "string", "error", "date" };
 
+static struct {			/* values of c@t */
+	char *name;
+	int type;
+	char *val;			/* name as shared by Fintern, see xmlintern */
+} Celltype[] = {
+	{ "inlineStr",	Inline },
+	{ "str",		String },
+	{ "s",			Shared },
+	{ "b",			Bool },
+	{ "d",			Date },
+	{ "e",			Error },
+	{ "n",			Numeric },
+};
+
+enum {				/* attributes decoded as the sheet is parsed, see xmlnumeric */
+	As,
+	Ar,
+	Amin,
+	Amax,
+	Awidth,
+	AdefaultColWidth,
+	Nnumattr
+};
+
+static char *Numattr[Nnumattr] = {
+	[As]		"s",
+	[Ar]		"r",
+	[Amin]		"min",
+	[Amax]		"max",
+	[Awidth]	"width",
+	[AdefaultColWidth]	"defaultColWidth",
+};
+
+static int Numatom[Nnumattr];	/* Numattr[] as atoms */
+
+static Xml *Doc;				/* each file is parsed into this in turn */
 static int Ncols;				/* number of columns in sheet */
 static int *Colwidth;			/* width of each column */
 static int Defwidth;			/* default column width if not set in aobve */
@@ -58,7 +110,7 @@ static void
 rd_inlinestr(Biobuf *bp, Elem *ep, int *widthp)
 {
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "t") == 0 && ep->child)
+		if(ep->atom == Atom[St] && ep->child)
 			rd_text(bp, ep->child, widthp);
 			
 }
@@ -112,7 +164,7 @@ inline_width(Elem *ep)
 	
 	n = 0;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "t") == 0 && ep->child && ep->child->pcdata)
+		if(ep->atom == Atom[St] && ep->child && ep->child->pcdata)
 			n += strlen(ep->child->pcdata);
 	return n;
 			
@@ -131,10 +183,10 @@ cellwidth(Elem *ep, int type, int style)
 			width++;
 		first = 0;
 
-		if(strcmp(ep->name, "is") == 0 && type == Inline && ep->child)
+		if(ep->atom == Atom[Sis] && type == Inline && ep->child)
 			width += inline_width(ep->child);
 
-		if(strcmp(ep->name, "v") == 0 && ep->pcdata)
+		if(ep->atom == Atom[Sv] && ep->pcdata)
 			switch(type){
 			case Shared:
 				width += strlen(lookstring(atoi(ep->pcdata)));
@@ -198,10 +250,10 @@ rd_c(Biobuf *bp, Elem *ep, int type, int style, int col)
 			Bprint(bp, " ");
 		first = 0;
 
-		if(strcmp(ep->name, "is") == 0 && type == Inline && ep->child)
+		if(ep->atom == Atom[Sis] && type == Inline && ep->child)
 			rd_inlinestr(bp, ep->child, &remain);
 
-		if(strcmp(ep->name, "v") == 0 && ep->pcdata)
+		if(ep->atom == Atom[Sv] && ep->pcdata)
 			switch(type){
 			case Shared:
 				prnt(bp, lookstring(atoi(ep->pcdata)), &remain);
@@ -239,13 +291,23 @@ rd_c(Biobuf *bp, Elem *ep, int type, int style, int col)
 }
 
 
-/* Only works for ASCII, but column labels are always A1 B2 etc. */
+/*
+ * the sheet is parsed with Fintern so the first loop
+ * nearly always finds it
+ */
 static int
-addr2col(char *s)
+celltype(char *v)
 {
-	if(isalpha(s[1]))
-		return (toupper(s[0]) - 'A') * 26 + (toupper(s[1]) - 'A');
-	return toupper(s[0]) - 'A';
+	int i;
+
+	for(i = 0; i < nelem(Celltype); i++)
+		if(v == Celltype[i].val)
+			return Celltype[i].type;
+	for(i = 0; i < nelem(Celltype); i++)
+		if(strcmp(v, Celltype[i].name) == 0)
+			return Celltype[i].type;
+	sysfatal("rd_row: type=%s unknown type\n", v);
+	return -1;
 }
 
 static void
@@ -259,7 +321,7 @@ rd_row(Biobuf *bp, Elem *ep)
 	first = 1;
 	notblank = 0;
 	for(; ep;  ep = ep->next)
-		if(strcmp(ep->name, "c") == 0 && ep->child){
+		if(ep->atom == Atom[Sc] && ep->child){
 
 			/* padding between columns (if there are more) */
 			if(! (first || skip(Colrange, col))){
@@ -272,31 +334,13 @@ rd_row(Biobuf *bp, Elem *ep)
 			first = 0;
 
 			type = Numeric;		/* default if no type set */
-			if((v = xmlvalue(ep, "t")) != nil){
-				if(strcmp(v, "inlineStr") == 0)
-					type = Inline;
-				else if(strcmp(v, "str") == 0)
-					type = String;
-				else if(strcmp(v, "s") == 0)
-					type = Shared;
-				else if(strcmp(v, "b") == 0)
-					type = Bool;
-				else if(strcmp(v, "d") == 0)
-					type = Date;
-				else if(strcmp(v, "e") == 0)
-					type = Error;
-				else if(strcmp(v, "n") == 0)
-					type = Numeric;
-				else
-					sysfatal("rd_row: type=%s unknown type\n", v);
-			}
+			if((v = xmlvalue(ep, "t")) != nil)
+				type = celltype(v);
 
-			style = 0;
-			if((v = xmlvalue(ep, "s")) != nil)
-				style = atoi(v);
+			style = xmlatomnum(ep, Numatom[As], 0);
 
-			if((v = xmlvalue(ep, "r")) != nil)
-				c = addr2col(v);
+			if(xmlatomcell(ep, Numatom[Ar], &c, nil) == 0)
+				c--;
 			else
 				c = col;
 
@@ -323,18 +367,15 @@ rd_row(Biobuf *bp, Elem *ep)
 static void
 rd_sheetdata(Biobuf *bp, Elem *ep)
 {
-	char *v;
 	int row, r;
 
 	row = 1;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "row") == 0 && ep->child){
-			if((v = xmlvalue(ep, "r")) != nil){
-				r = atoi(v);
-				if(Blanklines)
-					for(; row < r; row++)
-						Bprint(bp, "\n");
-			}
+		if(ep->atom == Atom[Srow] && ep->child){
+			r = xmlatomnum(ep, Numatom[Ar], row);
+			if(Blanklines)
+				for(; row < r; row++)
+					Bprint(bp, "\n");
 			rd_row(bp, ep->child);
 		}
 }
@@ -342,17 +383,14 @@ rd_sheetdata(Biobuf *bp, Elem *ep)
 static void
 rd_cols(Elem *base)
 {
-	char *v;
+	double width;
 	Elem *ep;
 	int min, max, i;
 
 	Ncols = 0;
 	for(ep = base; ep; ep = ep->next)
-			if((v = xmlvalue(ep, "max")) != nil){
-				i = atoi(v);
-				if(i > Ncols)
-					Ncols = i;
-			}
+			if((i = xmlatomnum(ep, Numatom[Amax], 0)) > Ncols)
+				Ncols = i;
 	
 	Colwidth = mallocz(Ncols * sizeof(int), 0);
 	if(Colwidth == nil)
@@ -360,17 +398,14 @@ rd_cols(Elem *base)
 
 	min = max = -1;
 	for(ep = base; ep; ep = ep->next){
-		if(strcmp(ep->name, "col") == 0){
-			if((v = xmlvalue(ep, "min")) != nil)
-				min = atoi(v);
+		if(ep->atom == Atom[Scol]){
+			min = xmlatomnum(ep, Numatom[Amin], min);
+			max = xmlatomnum(ep, Numatom[Amax], max);
 
-			if((v = xmlvalue(ep, "max")) != nil)
-				max = atoi(v);
-
-			if((v = xmlvalue(ep, "width")) != nil){
+			if((width = xmlatomnum(ep, Numatom[Awidth], -1)) >= 0){
 				if(min == -1 || max == -1)
 					sysfatal("badly formatted column widths\n");
-				Colwidth[min -1] = ceil(atof(v));			/* -1 as cols start at 1 */
+				Colwidth[min -1] = ceil(width);			/* -1 as cols start at 1 */
 
 				for(i = min+1; i <= max; i++)
 					Colwidth[i-1] = Colwidth[min-1];		/* -1 as cols start at 1 */
@@ -380,25 +415,30 @@ rd_cols(Elem *base)
 	}
 }
 
+/*
+ * each part is finished with before the next is read
+ * so they share one Xml and its memory.
+ */
 static Xml *
-parsefile(char *fmt, ...)
+parsefile(int flags, char *fmt, ...)
 {
 	char *s;
-	Xml *xp;
-	int fd;
+	int fd, rc;
 	va_list ap;
 
 	va_start(ap, fmt);
 	s = vsmprint(fmt, ap);
 	va_end(ap);
 
-	if((fd = open(s, OREAD)) == -1)
-		return nil;
-	if((xp = xmlparse(fd, 8192, Fcrushwhite)) == nil)
+	fd = open(s, OREAD);
+	free(s);
+	if(fd == -1)
 		return nil;
+	rc = xmlreparse(Doc, fd, flags);
 	close(fd);
-	free(s);
-	return xp;
+	if(rc == -1)
+		return nil;
+	return Doc;
 }
 
 static void
@@ -473,40 +513,50 @@ main(int argc, char *argv[])
 		usage();
 
 	quotefmtinstall();
+	for(i = 0; i < Natom; i++)
+		Atom[i] = xmlatom(Names[i]);
+	for(i = 0; i < nelem(Celltype); i++)
+		Celltype[i].val = xmlintern(Celltype[i].name);
 
 	Binit(&bout, 1, OWRITE);
-	if((xp = parsefile("%s/xl/sharedstrings.xml", argv[0])) != nil){
+	if((Doc = xmlnew(8192)) == nil)
+		sysfatal("no memory");
+	if((xp = parsefile(Fcrushwhite|Fparallel, "%s/xl/sharedstrings.xml", argv[0])) != nil){
 		if((ep = xmllook(xp->root, "/sst/si", nil, nil)) != nil)
 			rd_strings(ep);
-		xmlfree(xp);
 		if(dmpstr)
 			dumpstrings();
 	}
 
-	if((xp = parsefile("%s/xl/styles.xml", argv[0])) != nil){
+	if((xp = parsefile(Fcrushwhite|Fparallel, "%s/xl/styles.xml", argv[0])) != nil){
 		if((ep = xmllook(xp->root, "/styleSheet", nil, nil)) != nil && ep->child != nil)
 			rd_styles(ep->child);
-		xmlfree(xp);
 		if(dmpsty)
 			dumpstyles();
 	}
-	if((xp = parsefile("%s/xl/workbook.xml", argv[0])) != nil){
+	if((xp = parsefile(Fcrushwhite|Fparallel, "%s/xl/workbook.xml", argv[0])) != nil){
 		if((ep = xmllook(xp->root, "/workbook/workbookPr", nil, nil)) != nil)
 			if((v = xmlvalue(ep, "date1904")) != nil)
 				Epoch1904 = atoi(v);
-		xmlfree(xp);
 	}
 
-	if((xp = parsefile("%s/xl/worksheets/sheet%d.xml", argv[0], sheet)) == nil)
+	/*
+	 * only cols, sheetFormatPr and sheetData are wanted from
+	 * the sheet, the rest is never parsed.
+	 */
+	for(i = 0; i < Nnumattr; i++){
+		xmlnumeric(Doc, Numattr[i]);
+		Numatom[i] = xmlatom(Numattr[i]);
+	}
+	if((xp = parsefile(Fcrushwhite|Fparallel|Flazy|Fintern, "%s/xl/worksheets/sheet%d.xml", argv[0], sheet)) == nil)
 		sysfatal("sheet %d - cannot read %r", sheet);
 
-	if((ep = xmllook(xp->root, "/worksheet/cols", nil, nil)) != nil && ep->child != nil)
+	if((ep = xmllook(xp->root, "/worksheet/cols", nil, nil)) != nil && xmlchild(ep) != nil)
 		rd_cols(ep->child);
 
 	Defwidth = 10;
 	if((ep = xmllook(xp->root, "/worksheet/sheetFormatPr", nil, nil)) != nil)
-		if((v = xmlvalue(ep, "defaultColWidth")) != nil)
-			Defwidth = atoi(v);
+		Defwidth = xmlatomnum(ep, Numatom[AdefaultColWidth], Defwidth);
 
 	if(Tbl){
 		Bprint(&bout, ".LP\n");			/* bootstrap MS macros */
@@ -520,7 +570,7 @@ main(int argc, char *argv[])
 		Bprint(&bout, ".\n");
 	}
 
-	if((ep = xmllook(xp->root, "/worksheet/sheetData", nil, nil)) == nil || ep->child == nil)
+	if((ep = xmllook(xp->root, "/worksheet/sheetData", nil, nil)) == nil || xmlchild(ep) == nil)
 		sysfatal("/worksheet/sheetData not found in worksheet");
 	rd_sheetdata(&bout, ep->child);
 
@@ -2,6 +2,7 @@
 #include <libc.h>
 #include <bio.h>
 #include <xml.h>
+#include "xlsx.h"
 
 typedef struct Strtab Strtab;
 struct Strtab {
@@ -93,20 +94,20 @@ static void
 run(Elem *ep, int idx)
 {
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "t") == 0)
+		if(ep->atom == Atom[St])
 			if(ep->pcdata)
 				Root = add(Root, idx, ep->pcdata);
 			else
 				Root = add(Root, idx, "");		/* empty string */
 }
 
-void
-stringindex(Elem *ep, int idx)
+static void
+stringitem(Elem *ep, int idx)
 {
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "r") == 0 && ep->child)
+		if(ep->atom == Atom[Sr] && ep->child)
 			run(ep->child, idx);
-		if(strcmp(ep->name, "t") == 0)
+		if(ep->atom == Atom[St])
 			if(ep->pcdata)
 				Root = add(Root, idx, ep->pcdata);
 			else
@@ -121,8 +122,8 @@ rd_strings(Elem *ep)
 
 	idx = 0;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "si") == 0 && ep->child){
-			stringindex(ep->child, idx);
+		if(ep->atom == Atom[Ssi] && ep->child){
+			stringitem(ep->child, idx);
 			idx++;
 		}
 }
@@ -78,7 +78,7 @@ static void
 run(Elem *ep, int *idxp)
 {
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "t") == 0 && ep->pcdata)
+		if(ep->atom == Atom[St] && ep->pcdata)
 			Root = add(Root, (*idxp)++, ep->pcdata);
 }
 
@@ -86,9 +86,9 @@ void
 stringindex(Elem *ep, int *idxp)
 {
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "r") == 0 && ep->child)
+		if(ep->atom == Atom[Sr] && ep->child)
 			run(ep->child, idxp);
-		if(strcmp(ep->name, "t") == 0 && ep->pcdata)
+		if(ep->atom == Atom[St] && ep->pcdata)
 			Root = add(Root, (*idxp)++, ep->pcdata);
 	}
 }
@@ -100,7 +100,7 @@ mktab(Elem *ep)
 
 	idx = 0;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "si") == 0 && ep->child)
+		if(ep->atom == Atom[Ssi] && ep->child)
 			stringindex(ep->child, &idx);
 }
 
@@ -134,7 +134,7 @@ numfmts(Elem *ep)
 	id = -1;
 	fmt = nil;
 	for(; ep; ep = ep->next){
-		if(strcmp(ep->name, "numFmt") == 0){
+		if(ep->atom == Atom[SnumFmt]){
 			if((v = xmlvalue(ep, "numFmtId")) != nil)
 				id = atoi(v);
 			if((v = xmlvalue(ep, "formatCode")) != nil)
@@ -158,7 +158,7 @@ cellxfs(Elem *ep)
 
 	style = 0;
 	for(; ep; ep = ep->next)
-		if(strcmp(ep->name, "xf") == 0){
+		if(ep->atom == Atom[Sxf]){
 			enab = 0;
 			if((v = xmlvalue(ep, "applyNumberFormat")) != nil)
 				enab = atoi(v);
@@ -173,11 +173,10 @@ rd_styles(Elem *base)
 {
 	Elem *ep;
 
-	for(ep = base; ep; ep = ep->next)
-		if(strcmp(ep->name, "cellXfs") == 0 && ep->child)
-			cellxfs(ep->child);
 	for(ep = base; ep; ep = ep->next){
-		if(strcmp(ep->name, "numFmts") == 0 && ep->child)
+		if(ep->atom == Atom[ScellXfs] && ep->child)
+			cellxfs(ep->child);
+		if(ep->atom == Atom[SnumFmts] && ep->child)
 			numfmts(ep->child);
 	}
 }
@@ -11,12 +11,29 @@ enum {
 	Date,					/* ISO 8601 dates,  >= Excel 2010 only */
 };
 
+enum {				/* element names we dispatch on, see excel2txt.c */
+	Sc,
+	ScellXfs,
+	Scol,
+	Sis,
+	SnumFmt,
+	SnumFmts,
+	Sr,
+	Srow,
+	Ssi,
+	St,
+	Sv,
+	Sxf,
+	Natom
+};
+
+extern int Atom[Natom];		/* element names as atoms */
+
 /* fmtnum.c */
 int fmtnum(char *buf, int len, int id, char *str, int type);
 
 /* strings.c */
 char *lookstring(int idx);
-void stringindex(Elem *ep, int *idxp);
 void rd_strings(Elem *ep);
 
 /* strtab.c */